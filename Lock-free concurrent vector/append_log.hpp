@@ -0,0 +1,241 @@
+
+/*
+ * Append-only concurrent log, built on the bucket layout of the lock-free concurrent vector.
+ */
+
+#ifndef APPEND_LOG_HPP
+#define APPEND_LOG_HPP
+
+#include <atomic>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <iterator>
+#include <algorithm>
+#include "bucket_allocator.hpp"
+
+// Append-only log class implementation
+/* Elements are never removed or overwritten, so appends do not need the descriptor of the vector. An append claims its slot with a
+ * fetch_add on the tail, writes the element and then sets the slot's ready flag, which publishes it. Appends never wait for each
+ * other and the only location they all write is the tail.
+ * Since appends finish out of order, a slot below the tail is not necessarily ready. Readers use the committed prefix instead: the
+ * longest run of ready slots from the start of the log. It is kept in a watermark that only moves forward, and is advanced by the
+ * appender that finds it pointing at its own slot and by readers asking for the size, by walking the ready flags past it.
+ * The buckets follow the vector's layout: bucket k holds first_bucket_size << k slots, it is allocated by the first append that
+ * reaches it and it stays in place until the log is destroyed, so a published element never moves.
+ */
+template<typename T>
+class AppendLog {
+
+	// Slot of the log, holding an element once ready is set
+	struct Slot {
+		std::atomic<bool> ready;
+		alignas(T) unsigned char value[sizeof(T)];
+	};
+
+	static const int BUCKETS = 62;
+	static const int FIRST_BUCKET_SIZE = 2;
+	static const int FIRST_BUCKET_BIT = 1;
+
+	std::atomic<Slot *> memory[BUCKETS];
+	BucketAllocator allocator;
+	// The tail and the watermark are written by different threads, so each one has a cache line to itself
+	alignas(64) std::atomic<long long> tail;
+	alignas(64) std::atomic<long long> watermark;
+
+	// Function to get the highest set bit in a given integer
+	static int highest_bit(long long num) {
+		if(!num) return 0;
+		return 63 - __builtin_clzll(num);
+	}
+
+	static long long bucket_size(int bucket) {
+		return (long long)FIRST_BUCKET_SIZE << bucket;
+	}
+
+	// Function to get the bucket holding a given index
+	static int bucket_of(long long i) {
+		return highest_bit(i + FIRST_BUCKET_SIZE) - FIRST_BUCKET_BIT;
+	}
+
+	// Function to get the first index held by a given bucket
+	static long long bucket_start(int bucket) {
+		return bucket_size(bucket) - FIRST_BUCKET_SIZE;
+	}
+
+	// Function to get the slot of a given index, which must lie in an allocated bucket
+	Slot *slot(long long i) {
+		int bucket = bucket_of(i);
+		return memory[bucket].load(std::memory_order_acquire) + (i - bucket_start(bucket));
+	}
+
+	// Function to allocate a bucket if no other thread has done so yet
+	void alloc_bucket(int bucket) {
+		if(bucket >= BUCKETS || memory[bucket].load(std::memory_order_acquire) != NULL)
+			return;
+		Slot *expected = NULL;
+		Slot *array = (Slot *)allocator.allocate(bucket_size(bucket) * sizeof(Slot));
+		if(!memory[bucket].compare_exchange_strong(expected, array, std::memory_order_acq_rel))
+			allocator.deallocate(array, bucket_size(bucket) * sizeof(Slot));
+	}
+
+	// Function to get the slots [first, first + count) ready for writing, allocating any bucket they reach
+	/* The append that claims the first slot of a bucket also allocates the next one, so that appends running into a new bucket
+	 * usually find it in place instead of all allocating it at once.
+	 */
+	void reserve(long long first, long long count) {
+		int last = bucket_of(first + count - 1);
+		for(int bucket = bucket_of(first); bucket <= last; bucket++)
+			alloc_bucket(bucket);
+		if(first <= bucket_start(last) && bucket_start(last) < first + count)
+			alloc_bucket(last + 1);
+	}
+
+	// Function to check if the element at a given index has been published
+	// A slot can be claimed before its bucket is allocated, in which case it is not ready either.
+	bool ready(long long i) {
+		if(i < 0 || i >= tail.load(std::memory_order_acquire))
+			return false;
+		int bucket = bucket_of(i);
+		Slot *array = memory[bucket].load(std::memory_order_acquire);
+		return array != NULL && array[i - bucket_start(bucket)].ready.load(std::memory_order_acquire);
+	}
+
+	// Function to construct an element in a claimed slot and publish it
+	template<typename... Args>
+	void publish(long long i, Args&&... args) {
+		Slot *s = slot(i);
+		new (s->value) T(std::forward<Args>(args)...);
+		s->ready.store(true, std::memory_order_release);
+	}
+
+	// Function to move the watermark past every ready slot that directly follows it
+	/* A thread that moves the watermark walks on from where it stopped, to pick up the slots published in the meantime. An append
+	 * that saw an older watermark leaves the advance to others, but size() always walks, so a reader never misses a slot whose
+	 * append has returned.
+	 */
+	long long advance() {
+		long long committed = watermark.load(std::memory_order_acquire);
+		while(true) {
+			long long end = committed;
+			while(ready(end))
+				end++;
+			if(end == committed)
+				return committed;
+			// On failure another thread moved the watermark, possibly further, and the walk resumes from there
+			if(watermark.compare_exchange_weak(committed, end, std::memory_order_acq_rel, std::memory_order_acquire))
+				committed = end;
+			if(committed > end)
+				return committed;
+		}
+	}
+
+public:
+	// Public constructor
+	// The policy decides the page size, NUMA placement and pre-faulting of the large buckets, as for the vector.
+	AppendLog(const BucketPolicy &policy = BucketPolicy()) : allocator(policy), tail(0), watermark(0) {
+		for(int i = 0; i < BUCKETS; i++)
+			memory[i] = NULL;
+		alloc_bucket(0);
+	}
+
+	// The destructor must not run while appends are in progress, so every claimed slot holds an element by then
+	~AppendLog() {
+		long long size = tail.load();
+		for(int bucket = 0; bucket < BUCKETS; bucket++) {
+			Slot *array = memory[bucket].load();
+			if(array == NULL)
+				continue;
+			if(!std::is_trivially_destructible<T>::value) {
+				for(long long j = 0; j < bucket_size(bucket) && bucket_start(bucket) + j < size; j++)
+					((T *)array[j].value)->~T();
+			}
+			allocator.deallocate(array, bucket_size(bucket) * sizeof(Slot));
+		}
+	}
+
+	AppendLog(const AppendLog &) = delete;
+	AppendLog &operator=(const AppendLog &) = delete;
+
+	// Function to append a copy of an element to the log, returning its index
+	long long append(const T &data) {
+		return emplace(data);
+	}
+
+	long long append(T &&data) {
+		return emplace(std::move(data));
+	}
+
+	// Function to construct an element at the end of the log, returning its index
+	template<typename... Args>
+	long long emplace(Args&&... args) {
+		long long i = tail.fetch_add(1, std::memory_order_relaxed);
+		reserve(i, 1);
+		publish(i, std::forward<Args>(args)...);
+		if(watermark.load(std::memory_order_relaxed) == i)
+			advance();
+		return i;
+	}
+
+	// Function to append the elements of [first, last) to the log as one contiguous run, returning the index of the first one
+	// The whole run is claimed with a single fetch_add, so no other append lands between its elements.
+	template<typename InputIt>
+	long long append_n(InputIt first, InputIt last) {
+		long long count = std::distance(first, last);
+		long long start = tail.fetch_add(count, std::memory_order_relaxed);
+		if(count == 0)
+			return start;
+		reserve(start, count);
+		for(long long i = start; first != last; ++first, i++)
+			publish(i, *first);
+		if(watermark.load(std::memory_order_relaxed) == start)
+			advance();
+		return start;
+	}
+
+	// Function to get the committed prefix of the log, every element below which is ready to be read
+	long long size() {
+		return advance();
+	}
+
+	// Function to get the no. of claimed slots, including appends that have not finished yet
+	long long reserved() {
+		return tail.load(std::memory_order_relaxed);
+	}
+
+	// Function to get the element at a given index, which must be below a size returned earlier
+	const T &operator[](long long i) {
+		return *(const T *)slot(i)->value;
+	}
+
+	// Function to check if the element at a given index has been published, even if the committed prefix has not reached it
+	// If so, the element is copied to data.
+	bool try_read(long long i, T &data) {
+		if(!ready(i))
+			return false;
+		data = *(const T *)slot(i)->value;
+		return true;
+	}
+
+	// Function to call f(index, element) on the committed elements from a given index on, returning the index to resume from
+	// Calling it again with the returned index visits only the elements committed since, which makes it suitable for tailing.
+	template<typename F>
+	long long for_each(long long from, F f) {
+		long long end = size();
+		while(from < end) {
+			int bucket = bucket_of(from);
+			Slot *array = memory[bucket].load(std::memory_order_acquire);
+			long long stop = std::min(end, bucket_start(bucket) + bucket_size(bucket));
+			for(; from < stop; from++)
+				f(from, *(const T *)array[from - bucket_start(bucket)].value);
+		}
+		return from;
+	}
+
+	// Function to get the no. of buckets that asked for explicit huge pages but had to use transparent ones
+	long huge_page_fallbacks() {
+		return allocator.huge_page_fallbacks();
+	}
+};
+
+#endif
@@ -0,0 +1,111 @@
+/*
+ * Benchmark of appends to the append-only log against push_back() on the lock-free concurrent vector, for a growing no. of threads.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <pthread.h>
+#include <getopt.h>
+#include "lock_free_vector.hpp"
+#include "append_log.hpp"
+
+typedef std::chrono::steady_clock benchmark_clock;
+
+// Structure to pass on the parameters of a run to the appending threads
+template<typename Container>
+struct RunArguments {
+	Container *container;
+	long appends;
+	int batch;
+	std::atomic<int> *ready;
+	std::atomic<bool> *go;
+};
+
+void append_one(AppendLog<int> *log, int value) {
+	log->append(value);
+}
+
+void append_one(Vector<int> *vector, int value) {
+	vector->push_back(value);
+}
+
+void append_batch(AppendLog<int> *log, const std::vector<int> &batch) {
+	log->append_n(batch.begin(), batch.end());
+}
+
+void append_batch(Vector<int> *vector, const std::vector<int> &batch) {
+	vector->push_back_n(batch.begin(), batch.end());
+}
+
+// Function run by every appending thread
+template<typename Container>
+void *append_worker(void *ptr) {
+	RunArguments<Container> *args = (RunArguments<Container> *)ptr;
+	std::vector<int> batch(args->batch, 1);
+	args->ready->fetch_add(1);
+	while(!args->go->load())
+		;
+	if(args->batch > 1) {
+		for(long i = 0; i < args->appends; i += args->batch)
+			append_batch(args->container, batch);
+	}
+	else {
+		for(long i = 0; i < args->appends; i++)
+			append_one(args->container, i);
+	}
+	return NULL;
+}
+
+// Function to get the throughput in millions of appends per second of a run with a given no. of threads
+template<typename Container>
+double run(int threads, long appends, int batch) {
+	Container *container = new Container();
+	std::atomic<int> ready(0);
+	std::atomic<bool> go(false);
+	RunArguments<Container> args = {container, appends, batch, &ready, &go};
+	std::vector<pthread_t> thread(threads);
+	for(int i = 0; i < threads; i++)
+		pthread_create(&thread[i], NULL, append_worker<Container>, &args);
+	// The threads wait until all of them are running, so the timed region excludes thread creation
+	while(ready.load() < threads)
+		;
+	auto t1 = benchmark_clock::now();
+	go = true;
+	for(int i = 0; i < threads; i++)
+		pthread_join(thread[i], NULL);
+	double seconds = std::chrono::duration<double>(benchmark_clock::now() - t1).count();
+	delete container;
+	return threads * appends / seconds / 1e6;
+}
+
+// Main function
+int main(int argc, char **argv) {
+	int max_threads = 8;
+	long appends = 1000000;
+	int batch = 1;
+	int c;
+	while((c = getopt(argc, argv, "t:n:b:")) != -1) {
+		switch(c) {
+		case 't': max_threads = atoi(optarg); break;
+		case 'n': appends = atol(optarg); break;
+		case 'b': batch = atoi(optarg); break;
+		default:
+			std::cerr << "Usage: " << argv[0] << " [-t max threads] [-n appends per thread] [-b batch size]" << std::endl;
+			return 1;
+		}
+	}
+
+	std::cout << appends << " appends per thread, batches of " << batch << std::endl;
+	std::cout << std::setw(8) << "threads" << std::setw(16) << "log Mops/s" << std::setw(16) << "vector Mops/s" << std::setw(10)
+		<< "ratio" << std::endl;
+	for(int threads = 1; threads <= max_threads; threads *= 2) {
+		double log = run<AppendLog<int> >(threads, appends, batch);
+		double vector = run<Vector<int> >(threads, appends, batch);
+		std::cout << std::setw(8) << threads << std::fixed << std::setprecision(2) << std::setw(16) << log << std::setw(16) << vector
+			<< std::setw(10) << log / vector << std::endl;
+	}
+	return 0;
+}
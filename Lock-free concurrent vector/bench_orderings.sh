@@ -0,0 +1,44 @@
+#!/bin/sh
+# Compares the throughput of the lock-free vector with its weakened memory orderings against a build with -DVECTOR_SEQ_CST, where
+# every ordering is seq_cst again. Both builds run the benchmark with the same options, and the mean throughput of each thread
+# count is printed side by side.
+# Usage: ./bench_orderings.sh [benchmark options], e.g. ./bench_orderings.sh --threads 1-8 --mixed --repeat 5
+# The compiler and extra flags, such as -DVECTOR_WAIT_FREE, are taken from CXX and CXXFLAGS.
+
+set -e
+cd "$(dirname "$0")"
+CXX=${CXX:-g++}
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+$CXX -std=c++17 -O2 $CXXFLAGS -pthread lock_free_vector.cpp -o "$dir/weakened"
+$CXX -std=c++17 -O2 $CXXFLAGS -DVECTOR_SEQ_CST -pthread lock_free_vector.cpp -o "$dir/seq_cst"
+"$dir/weakened" "$@" --format csv > "$dir/weakened.csv"
+"$dir/seq_cst" "$@" --format csv > "$dir/seq_cst.csv"
+
+# Mean of the ops_per_sec column over the runs of every thread count, which is the first column
+awk -F, '
+	FNR == 1 {
+		for(i = 1; i <= NF; i++)
+			if($i == "ops_per_sec")
+				column = i
+		build = FILENAME ~ /seq_cst/ ? "seq_cst" : "weakened"
+		next
+	}
+	{
+		sum[build, $1] += $column
+		runs[build, $1]++
+		if(!($1 in seen)) {
+			seen[$1] = 1
+			order[++threads] = $1
+		}
+	}
+	END {
+		printf "%8s %16s %16s %8s\n", "threads", "weakened Mops/s", "seq_cst Mops/s", "ratio"
+		for(i = 1; i <= threads; i++) {
+			t = order[i]
+			weakened = sum["weakened", t] / runs["weakened", t] / 1e6
+			seq_cst = sum["seq_cst", t] / runs["seq_cst", t] / 1e6
+			printf "%8s %16.2f %16.2f %8.2f\n", t, weakened, seq_cst, weakened / seq_cst
+		}
+	}' "$dir/weakened.csv" "$dir/seq_cst.csv"
@@ -0,0 +1,175 @@
+
+/*
+ * Allocation policies for the buckets of the lock-free concurrent vector: page size, NUMA placement and pre-faulting.
+ */
+
+#ifndef BUCKET_ALLOCATOR_HPP
+#define BUCKET_ALLOCATOR_HPP
+
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// Policy used to allocate the buckets of a vector
+/* Buckets smaller than min_bytes always come from calloc(). With the default policy so do all the others, which leaves the page
+ * size and placement to the allocator and the OS. Otherwise large buckets are mapped directly, so that they can be:
+ *  - backed by transparent huge pages (madvise(MADV_HUGEPAGE)) or by explicit huge pages (MAP_HUGETLB), which fall back to
+ *    transparent ones if no huge pages are reserved,
+ *  - placed on the NUMA node of the thread that first writes each page (FIRST_TOUCH, the kernel default) or interleaved page by
+ *    page across all the nodes (INTERLEAVE), which spreads the bandwidth of scans over every memory controller,
+ *  - pre-faulted when they are allocated, which moves the cost of the page faults out of the pushes that first reach the pages.
+ *    With FIRST_TOUCH the pages then all land on the node of the allocating thread.
+ */
+struct BucketPolicy {
+	enum PageSize {SMALL_PAGES, TRANSPARENT_HUGE_PAGES, EXPLICIT_HUGE_PAGES};
+	enum Placement {FIRST_TOUCH, INTERLEAVE};
+	static const size_t HUGE_PAGE_SIZE = 2 << 20;
+
+	PageSize pages;
+	Placement placement;
+	bool prefault;
+	size_t min_bytes;
+
+	BucketPolicy(PageSize p = SMALL_PAGES, Placement n = FIRST_TOUCH, bool f = false, size_t m = HUGE_PAGE_SIZE)
+		: pages(p), placement(n), prefault(f), min_bytes(m) {}
+
+	// Function to check if buckets of a given size are mapped directly rather than taken from calloc()
+	bool maps(size_t bytes) const {
+		return bytes >= min_bytes && (pages != SMALL_PAGES || placement != FIRST_TOUCH || prefault);
+	}
+};
+
+// Allocator implementing a bucket policy
+class BucketAllocator {
+
+	// Constants from <numaif.h>, which is not always installed. mbind() is called through syscall() so that no library is needed.
+	static const int MPOL_INTERLEAVE_MODE = 3;
+
+	BucketPolicy policy;
+	// No. of buckets that asked for explicit huge pages but got transparent ones
+	std::atomic<long> fallbacks;
+
+	// Function to get the bytes mapped for a bucket, which are rounded up to whole huge pages
+	static size_t mapped_bytes(size_t bytes) {
+		return (bytes + BucketPolicy::HUGE_PAGE_SIZE - 1) / BucketPolicy::HUGE_PAGE_SIZE * BucketPolicy::HUGE_PAGE_SIZE;
+	}
+
+	// Function to get the mask of online NUMA nodes, empty if it cannot be read
+	static std::vector<unsigned long> online_nodes() {
+		std::vector<unsigned long> mask;
+		std::ifstream online("/sys/devices/system/node/online");
+		std::string ranges;
+		if(!(online >> ranges))
+			return mask;
+		size_t i = 0;
+		while(i < ranges.size()) {
+			size_t end;
+			unsigned long first = std::stoul(ranges.substr(i), &end);
+			unsigned long last = first;
+			i += end;
+			if(i < ranges.size() && ranges[i] == '-') {
+				last = std::stoul(ranges.substr(i + 1), &end);
+				i += end + 1;
+			}
+			for(unsigned long node = first; node <= last; node++) {
+				if(mask.size() <= node / 64)
+					mask.resize(node / 64 + 1, 0);
+				mask[node / 64] |= 1UL << (node % 64);
+			}
+			if(i < ranges.size() && ranges[i] == ',')
+				i++;
+		}
+		return mask;
+	}
+
+	// Function to map an anonymous region aligned to a huge page, so that transparent huge pages can back all of it
+	static void *map_aligned(size_t bytes) {
+		size_t padded = bytes + BucketPolicy::HUGE_PAGE_SIZE;
+		void *region = mmap(NULL, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if(region == MAP_FAILED)
+			return NULL;
+		uintptr_t start = (uintptr_t)region;
+		uintptr_t aligned = (start + BucketPolicy::HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(BucketPolicy::HUGE_PAGE_SIZE - 1);
+		if(aligned > start)
+			munmap(region, aligned - start);
+		if(start + padded > aligned + bytes)
+			munmap((void *)(aligned + bytes), start + padded - aligned - bytes);
+		return (void *)aligned;
+	}
+
+public:
+	BucketAllocator(const BucketPolicy &p = BucketPolicy()) : policy(p), fallbacks(0) {}
+
+	// Function to allocate a zeroed bucket of the given size
+	void *allocate(size_t bytes) {
+		if(!policy.maps(bytes)) {
+			void *block = std::calloc(1, bytes);
+			if(block == NULL)
+				throw std::bad_alloc();
+			return block;
+		}
+		size_t length = mapped_bytes(bytes);
+		void *block = NULL;
+		if(policy.pages == BucketPolicy::EXPLICIT_HUGE_PAGES) {
+			block = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if(block == MAP_FAILED) {
+				block = NULL;
+				fallbacks.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+		if(block == NULL) {
+			block = map_aligned(length);
+			if(block == NULL)
+				throw std::bad_alloc();
+			madvise(block, length, policy.pages == BucketPolicy::SMALL_PAGES ? MADV_NOHUGEPAGE : MADV_HUGEPAGE);
+		}
+		// The placement has to be set before any page is touched
+		if(policy.placement == BucketPolicy::INTERLEAVE) {
+			std::vector<unsigned long> nodes = online_nodes();
+			if(!nodes.empty())
+				syscall(SYS_mbind, block, length, MPOL_INTERLEAVE_MODE, nodes.data(), nodes.size() * 64 + 1, 0);
+		}
+		if(policy.prefault) {
+			long page = sysconf(_SC_PAGESIZE);
+			for(size_t offset = 0; offset < length; offset += page)
+				((volatile char *)block)[offset] = 0;
+		}
+		return block;
+	}
+
+	// Function to free a bucket allocated with the given size
+	void deallocate(void *block, size_t bytes) {
+		release(block, mapped_length(bytes));
+	}
+
+	// Function to get the length of the mapping of a bucket of the given size, 0 if it comes from calloc()
+	size_t mapped_length(size_t bytes) const {
+		return policy.maps(bytes) ? mapped_bytes(bytes) : 0;
+	}
+
+	// Function to free a bucket given the length of its mapping, which does not need the allocator that allocated it
+	static void release(void *block, size_t length) {
+		if(length == 0)
+			std::free(block);
+		else
+			munmap(block, length);
+	}
+
+	const BucketPolicy &bucket_policy() const {
+		return policy;
+	}
+
+	// Function to get the no. of buckets that fell back from explicit to transparent huge pages
+	long huge_page_fallbacks() const {
+		return fallbacks.load();
+	}
+};
+
+#endif
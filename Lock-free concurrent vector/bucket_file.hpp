@@ -0,0 +1,205 @@
+
+/*
+ * Memory-mapped data file that backs the buckets of a persistent lock-free concurrent vector.
+ */
+
+#ifndef BUCKET_FILE_HPP
+#define BUCKET_FILE_HPP
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <stdexcept>
+#include <mutex>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Data file holding the buckets of a vector
+/* The file starts with a one page header, followed by the buckets in order. Each bucket starts on a page boundary so that it can be
+ * mapped on its own, and the file only grows as buckets are allocated. Bucket pages that were never written are holes in the file.
+ * The header keeps two commit records, each with the size of the vector at a checkpoint, a sequence no. and a checksum. A checkpoint
+ * flushes the buckets first and then overwrites the older record, so a crash part way through leaves the newer record intact and
+ * the size that is recovered on reopening never covers elements that did not make it to the file.
+ */
+class BucketFile {
+
+	static const uint64_t MAGIC = 0x5643454656434c46ULL;
+	static const uint32_t VERSION = 1;
+
+	struct CommitRecord {
+		uint64_t sequence;
+		uint64_t size;
+		uint64_t checksum;
+	};
+
+	struct Header {
+		uint64_t magic;
+		uint32_t version;
+		uint32_t slot_size;
+		uint32_t first_bucket_size;
+		uint32_t alignment;
+		CommitRecord commits[2];
+	};
+
+	int fd;
+	Header *header;
+	// Length of the mapping of the header, which is one page of this machine even if the file was written with larger pages
+	size_t header_length;
+	size_t alignment;
+	size_t slot_size;
+	int first_bucket_size;
+	// Serializes growing the file, since ftruncate() of a smaller bucket must not shrink the file under a larger one
+	std::mutex grow_lock;
+	off_t file_size;
+
+	static uint64_t checksum(const CommitRecord &record) {
+		uint64_t h = MAGIC ^ (record.sequence * 0x9e3779b97f4a7c15ULL);
+		h ^= record.size + 0x632be59bd9b4e019ULL + (h << 6) + (h >> 2);
+		return h;
+	}
+
+	static bool valid(const CommitRecord &record) {
+		return record.sequence != 0 && record.checksum == checksum(record);
+	}
+
+	// Function to get the index of the latest valid commit record, -1 if there is none
+	int latest_commit() const {
+		int latest = -1;
+		for(int i = 0; i < 2; i++) {
+			if(valid(header->commits[i]) && (latest < 0 || header->commits[i].sequence > header->commits[latest].sequence))
+				latest = i;
+		}
+		return latest;
+	}
+
+	// Function to get the no. of bytes a bucket takes in the file, rounded up to the next page
+	size_t bucket_bytes(int bucket) const {
+		size_t bytes = ((size_t)first_bucket_size << bucket) * slot_size;
+		return (bytes + alignment - 1) / alignment * alignment;
+	}
+
+	off_t bucket_offset(int bucket) const {
+		off_t offset = alignment;
+		for(int i = 0; i < bucket; i++)
+			offset += bucket_bytes(i);
+		return offset;
+	}
+
+	void fail(const std::string &what) {
+		std::string message = "BucketFile: " + what + ": " + strerror(errno);
+		if(header != NULL)
+			munmap(header, header_length);
+		if(fd >= 0)
+			close(fd);
+		throw std::runtime_error(message);
+	}
+
+public:
+	// Public constructor
+	// Opens the file at path, creating it if it does not exist. Throws std::runtime_error if the file cannot be opened or was
+	// written for a different element size or bucket layout.
+	BucketFile(const std::string &path, size_t slot, int first_bucket) : header(NULL), slot_size(slot), first_bucket_size(first_bucket) {
+		alignment = sysconf(_SC_PAGESIZE);
+		header_length = alignment;
+		fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+		if(fd < 0)
+			fail("cannot open " + path);
+		struct stat st;
+		if(fstat(fd, &st) != 0)
+			fail("cannot stat " + path);
+		file_size = st.st_size;
+		bool created = file_size == 0;
+		if(created) {
+			if(ftruncate(fd, alignment) != 0)
+				fail("cannot grow " + path);
+			file_size = alignment;
+		}
+		else if(file_size < (off_t)sizeof(Header)) {
+			errno = EINVAL;
+			fail(path + " is not a vector file");
+		}
+		void *address = mmap(NULL, header_length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if(address == MAP_FAILED)
+			fail("cannot map the header of " + path);
+		header = (Header *)address;
+		if(created) {
+			header->magic = MAGIC;
+			header->version = VERSION;
+			header->slot_size = slot_size;
+			header->first_bucket_size = first_bucket_size;
+			header->alignment = alignment;
+			commit(0);
+			return;
+		}
+		errno = EINVAL;
+		if(header->magic != MAGIC || header->version != VERSION)
+			fail(path + " is not a vector file");
+		if(header->slot_size != slot_size || header->first_bucket_size != (uint32_t)first_bucket_size)
+			fail(path + " was written for a different element type");
+		if(header->alignment % alignment != 0)
+			fail(path + " was written with an incompatible page size");
+		alignment = header->alignment;
+		if(latest_commit() < 0)
+			fail(path + " has no valid commit record");
+	}
+
+	~BucketFile() {
+		munmap(header, header_length);
+		close(fd);
+	}
+
+	// Function to get the size of the vector at the last checkpoint
+	long long committed_size() const {
+		return header->commits[latest_commit()].size;
+	}
+
+	// Function to map a bucket, growing the file if the bucket does not exist yet
+	// Mapping the same bucket twice is harmless, as both mappings share the file's pages.
+	void *map(int bucket) {
+		off_t offset = bucket_offset(bucket);
+		size_t bytes = bucket_bytes(bucket);
+		{
+			std::lock_guard<std::mutex> lock(grow_lock);
+			if(file_size < offset + (off_t)bytes) {
+				if(ftruncate(fd, offset + bytes) != 0)
+					throw std::bad_alloc();
+				file_size = offset + bytes;
+			}
+		}
+		void *address = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+		if(address == MAP_FAILED)
+			throw std::bad_alloc();
+		return address;
+	}
+
+	void unmap(int bucket, void *address) {
+		munmap(address, bucket_bytes(bucket));
+	}
+
+	// Function to get the length of the mapping of a bucket
+	size_t mapped_length(int bucket) const {
+		return bucket_bytes(bucket);
+	}
+
+	// Function to write the first slots of a mapped bucket back to the file
+	void flush(void *address, long long slots) {
+		if(slots > 0)
+			msync(address, slots * slot_size, MS_SYNC);
+	}
+
+	// Function to record a new committed size
+	// The buckets holding the elements below size must have been flushed first. Calls must not overlap.
+	void commit(long long size) {
+		int latest = latest_commit();
+		CommitRecord &record = header->commits[latest == 0 ? 1 : 0];
+		record.sequence = latest < 0 ? 1 : header->commits[latest].sequence + 1;
+		record.size = size;
+		record.checksum = checksum(record);
+		msync(header, header_length, MS_SYNC);
+	}
+};
+
+#endif
@@ -0,0 +1,231 @@
+
+/*
+ * Vectorized search, count and min/max kernels over the contiguous int arrays of the lock-free concurrent vector's buckets.
+ */
+
+#ifndef BUCKET_KERNELS_HPP
+#define BUCKET_KERNELS_HPP
+
+#include <climits>
+#include <algorithm>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BUCKET_KERNELS_X86
+#endif
+
+// Kernels over an array of ints, with one implementation per instruction set
+/* The AVX2 and SSE4.1 versions are compiled with target attributes, so the rest of the program does not need -mavx2, and the
+ * level is picked once at run time from what the cpu supports. Every kernel handles the elements that do not fill a whole register
+ * with the scalar version. On other architectures only the scalar versions are compiled in.
+ */
+class BucketKernels {
+public:
+	enum Level {SCALAR, SSE41, AVX2};
+
+private:
+	static Level detect() {
+#ifdef BUCKET_KERNELS_X86
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx2"))
+			return AVX2;
+		if(__builtin_cpu_supports("sse4.1"))
+			return SSE41;
+#endif
+		return SCALAR;
+	}
+
+	static Level &current() {
+		static Level level = detect();
+		return level;
+	}
+
+	// Scalar kernels
+	static long long find_scalar(const int *a, long long n, int value) {
+		for(long long i = 0; i < n; i++) {
+			if(a[i] == value)
+				return i;
+		}
+		return -1;
+	}
+
+	static long long count_scalar(const int *a, long long n, int value) {
+		long long count = 0;
+		for(long long i = 0; i < n; i++)
+			count += a[i] == value;
+		return count;
+	}
+
+	static void minmax_scalar(const int *a, long long n, int &low, int &high) {
+		for(long long i = 0; i < n; i++) {
+			low = a[i] < low ? a[i] : low;
+			high = a[i] > high ? a[i] : high;
+		}
+	}
+
+#ifdef BUCKET_KERNELS_X86
+	// AVX2 kernels, 8 ints per register
+	__attribute__((target("avx2")))
+	static long long find_avx2(const int *a, long long n, int value) {
+		__m256i v = _mm256_set1_epi32(value);
+		long long i = 0;
+		for(; i + 16 <= n; i += 16) {
+			__m256i e0 = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(a + i)), v);
+			__m256i e1 = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(a + i + 8)), v);
+			if(!_mm256_testz_si256(_mm256_or_si256(e0, e1), _mm256_or_si256(e0, e1))) {
+				unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(e0)) | _mm256_movemask_ps(_mm256_castsi256_ps(e1)) << 8;
+				return i + __builtin_ctz(mask);
+			}
+		}
+		long long found = find_scalar(a + i, n - i, value);
+		return found < 0 ? -1 : i + found;
+	}
+
+	// Matches are counted per lane by subtracting the all-ones compare results, and the lanes are summed every 2^28 registers,
+	// well before a lane can overflow
+	__attribute__((target("avx2")))
+	static long long count_avx2(const int *a, long long n, int value) {
+		__m256i v = _mm256_set1_epi32(value);
+		long long count = 0;
+		long long i = 0;
+		while(i + 8 <= n) {
+			long long stop = std::min(n - (n - i) % 8, i + (8LL << 28));
+			__m256i acc = _mm256_setzero_si256();
+			for(; i < stop; i += 8)
+				acc = _mm256_sub_epi32(acc, _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(a + i)), v));
+			int lanes[8];
+			_mm256_storeu_si256((__m256i *)lanes, acc);
+			for(int j = 0; j < 8; j++)
+				count += (unsigned)lanes[j];
+		}
+		return count + count_scalar(a + i, n - i, value);
+	}
+
+	__attribute__((target("avx2")))
+	static void minmax_avx2(const int *a, long long n, int &low, int &high) {
+		__m256i lo = _mm256_set1_epi32(low), hi = _mm256_set1_epi32(high);
+		long long i = 0;
+		for(; i + 8 <= n; i += 8) {
+			__m256i e = _mm256_loadu_si256((const __m256i *)(a + i));
+			lo = _mm256_min_epi32(lo, e);
+			hi = _mm256_max_epi32(hi, e);
+		}
+		int lows[8], highs[8];
+		_mm256_storeu_si256((__m256i *)lows, lo);
+		_mm256_storeu_si256((__m256i *)highs, hi);
+		for(int j = 0; j < 8; j++) {
+			low = lows[j] < low ? lows[j] : low;
+			high = highs[j] > high ? highs[j] : high;
+		}
+		minmax_scalar(a + i, n - i, low, high);
+	}
+
+	// SSE4.1 kernels, 4 ints per register
+	__attribute__((target("sse4.1")))
+	static long long find_sse41(const int *a, long long n, int value) {
+		__m128i v = _mm_set1_epi32(value);
+		long long i = 0;
+		for(; i + 8 <= n; i += 8) {
+			__m128i e0 = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(a + i)), v);
+			__m128i e1 = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(a + i + 4)), v);
+			unsigned mask = _mm_movemask_ps(_mm_castsi128_ps(e0)) | _mm_movemask_ps(_mm_castsi128_ps(e1)) << 4;
+			if(mask != 0)
+				return i + __builtin_ctz(mask);
+		}
+		long long found = find_scalar(a + i, n - i, value);
+		return found < 0 ? -1 : i + found;
+	}
+
+	__attribute__((target("sse4.1")))
+	static long long count_sse41(const int *a, long long n, int value) {
+		__m128i v = _mm_set1_epi32(value);
+		long long count = 0;
+		long long i = 0;
+		while(i + 4 <= n) {
+			long long stop = std::min(n - (n - i) % 4, i + (4LL << 28));
+			__m128i acc = _mm_setzero_si128();
+			for(; i < stop; i += 4)
+				acc = _mm_sub_epi32(acc, _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(a + i)), v));
+			int lanes[4];
+			_mm_storeu_si128((__m128i *)lanes, acc);
+			for(int j = 0; j < 4; j++)
+				count += (unsigned)lanes[j];
+		}
+		return count + count_scalar(a + i, n - i, value);
+	}
+
+	__attribute__((target("sse4.1")))
+	static void minmax_sse41(const int *a, long long n, int &low, int &high) {
+		__m128i lo = _mm_set1_epi32(low), hi = _mm_set1_epi32(high);
+		long long i = 0;
+		for(; i + 4 <= n; i += 4) {
+			__m128i e = _mm_loadu_si128((const __m128i *)(a + i));
+			lo = _mm_min_epi32(lo, e);
+			hi = _mm_max_epi32(hi, e);
+		}
+		int lows[4], highs[4];
+		_mm_storeu_si128((__m128i *)lows, lo);
+		_mm_storeu_si128((__m128i *)highs, hi);
+		for(int j = 0; j < 4; j++) {
+			low = lows[j] < low ? lows[j] : low;
+			high = highs[j] > high ? highs[j] : high;
+		}
+		minmax_scalar(a + i, n - i, low, high);
+	}
+#endif
+
+public:
+	// Function to get the instruction set the kernels use
+	static Level level() {
+		return current();
+	}
+
+	// Function to choose the instruction set, which is capped at what the cpu supports. Meant for benchmarks and must not be called
+	// while kernels are running.
+	static Level set_level(Level level) {
+		current() = level < detect() ? level : detect();
+		return current();
+	}
+
+	static const char *name(Level level) {
+		return level == AVX2 ? "avx2" : level == SSE41 ? "sse4.1" : "scalar";
+	}
+
+	// Function to find the offset of the first element of a[0, n) equal to value, -1 if there is none
+	static long long find(const int *a, long long n, int value) {
+#ifdef BUCKET_KERNELS_X86
+		if(current() == AVX2)
+			return find_avx2(a, n, value);
+		if(current() == SSE41)
+			return find_sse41(a, n, value);
+#endif
+		return find_scalar(a, n, value);
+	}
+
+	// Function to count the elements of a[0, n) equal to value
+	static long long count(const int *a, long long n, int value) {
+#ifdef BUCKET_KERNELS_X86
+		if(current() == AVX2)
+			return count_avx2(a, n, value);
+		if(current() == SSE41)
+			return count_sse41(a, n, value);
+#endif
+		return count_scalar(a, n, value);
+	}
+
+	// Function to lower low to the minimum and raise high to the maximum of a[0, n)
+	static void minmax(const int *a, long long n, int &low, int &high) {
+#ifdef BUCKET_KERNELS_X86
+		if(current() == AVX2) {
+			minmax_avx2(a, n, low, high);
+			return;
+		}
+		if(current() == SSE41) {
+			minmax_sse41(a, n, low, high);
+			return;
+		}
+#endif
+		minmax_scalar(a, n, low, high);
+	}
+};
+
+#endif
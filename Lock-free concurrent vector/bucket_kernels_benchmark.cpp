@@ -0,0 +1,115 @@
+/*
+ * Benchmark of the bulk queries of the lock-free concurrent vector, index_of(), count() and min()/max(), with each instruction set
+ * the kernels support, against the same queries made element by element with at().
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <climits>
+#include <getopt.h>
+#include "lock_free_vector.hpp"
+
+typedef std::chrono::steady_clock benchmark_clock;
+
+// Results of the queries are written here, so that the compiler cannot drop them
+volatile long long sink;
+
+// Function to get the best time in milliseconds of a query over a number of repetitions
+template<typename F>
+double best_ms(int repetitions, F query) {
+	double best = 0;
+	for(int i = 0; i < repetitions; i++) {
+		auto t1 = benchmark_clock::now();
+		sink = query();
+		double ms = std::chrono::duration<double, std::milli>(benchmark_clock::now() - t1).count();
+		best = i == 0 || ms < best ? ms : best;
+	}
+	return best;
+}
+
+// Function to print a row of results
+void print_row(const char *path, long long elements, double find, double count, double minmax) {
+	double bytes = elements * sizeof(int);
+	std::cout << std::left << std::setw(18) << path << std::right << std::fixed << std::setprecision(2)
+		<< std::setw(12) << find << std::setw(12) << count << std::setw(12) << minmax
+		<< std::setw(14) << bytes / (count / 1000) / 1e9 << std::endl;
+}
+
+// Main function
+int main(int argc, char **argv) {
+	long long elements = 1LL << 25;
+	int threads = 1;
+	int repetitions = 5;
+	int c;
+	while((c = getopt(argc, argv, "n:t:r:")) != -1) {
+		switch(c) {
+		case 'n': elements = atoll(optarg); break;
+		case 't': threads = atoi(optarg); break;
+		case 'r': repetitions = atoi(optarg); break;
+		default:
+			std::cerr << "Usage: " << argv[0] << " [-n elements] [-t threads] [-r repetitions]" << std::endl;
+			return 1;
+		}
+	}
+
+	// Fill the vector with pseudo-random values. The value searched for is never present, so index_of() scans the whole vector.
+	Vector<int> v;
+	std::vector<int> batch(1 << 16);
+	unsigned int seed = 2463534242u;
+	while(v.size() < elements) {
+		long long n = std::min((long long)batch.size(), elements - v.size());
+		for(long long i = 0; i < n; i++) {
+			seed ^= seed << 13;
+			seed ^= seed >> 17;
+			seed ^= seed << 5;
+			batch[i] = (int)(seed % 1000000);
+		}
+		v.push_back_n(batch.begin(), batch.begin() + n);
+	}
+	const int missing = -1;
+
+	std::cout << elements << " ints, " << threads << " threads, best of " << repetitions << std::endl;
+	std::cout << std::left << std::setw(18) << "path" << std::right << std::setw(12) << "find ms" << std::setw(12) << "count ms"
+		<< std::setw(12) << "minmax ms" << std::setw(14) << "count GB/s" << std::endl;
+
+	// Element by element, the way these queries had to be written before
+	double find = best_ms(repetitions, [&]() {
+		long long size = v.size();
+		for(long long i = 0; i < size; i++) {
+			if(v.at(i)->load(std::memory_order_relaxed) == missing)
+				return i;
+		}
+		return -1LL;
+	});
+	double count = best_ms(repetitions, [&]() {
+		long long size = v.size(), matches = 0;
+		for(long long i = 0; i < size; i++)
+			matches += v.at(i)->load(std::memory_order_relaxed) == missing;
+		return matches;
+	});
+	double minmax = best_ms(repetitions, [&]() {
+		long long size = v.size();
+		int low = INT_MAX, high = INT_MIN;
+		for(long long i = 0; i < size; i++) {
+			int e = v.at(i)->load(std::memory_order_relaxed);
+			low = std::min(low, e);
+			high = std::max(high, e);
+		}
+		return (long long)low + high;
+	});
+	print_row("at(i)", elements, find, count, minmax);
+
+	// Bulk queries, with every instruction set up to the best one the cpu supports
+	BucketKernels::Level best = BucketKernels::level();
+	for(int level = BucketKernels::SCALAR; level <= best; level++) {
+		BucketKernels::set_level((BucketKernels::Level)level);
+		find = best_ms(repetitions, [&]() {return v.index_of(missing, threads);});
+		count = best_ms(repetitions, [&]() {return v.count(missing, threads);});
+		// Both bounds are timed, as on the at(i) path, although min() and max() scan the vector once each
+		minmax = best_ms(repetitions, [&]() {return (long long)*v.min(threads) + *v.max(threads);});
+		print_row(BucketKernels::name((BucketKernels::Level)level), elements, find, count, minmax);
+	}
+	return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * Benchmark of the bucket allocation policies of the lock-free concurrent vector on large vectors: page size, NUMA placement and
+ * pre-faulting, measured on filling the vector, scanning it and reading it at random.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <getopt.h>
+#include "lock_free_vector.hpp"
+
+typedef std::chrono::steady_clock benchmark_clock;
+
+// Results of the scans and reads are written here, so that the compiler cannot drop them
+volatile long long sink;
+
+// Structure to hold a policy along with the name it is reported under
+struct NamedPolicy {
+	const char *name;
+	BucketPolicy policy;
+};
+
+// Function to get a field of /proc/self/smaps_rollup in kilobytes, -1 if it is not available
+long smaps_kb(const std::string &field) {
+	std::ifstream smaps("/proc/self/smaps_rollup");
+	std::string line;
+	while(std::getline(smaps, line)) {
+		if(line.compare(0, field.size() + 1, field + ":") == 0) {
+			std::istringstream ss(line.substr(field.size() + 1));
+			long kb;
+			if(ss >> kb)
+				return kb;
+		}
+	}
+	return -1;
+}
+
+// Function to get the seconds elapsed since a given time
+double seconds_since(benchmark_clock::time_point start) {
+	return std::chrono::duration<double>(benchmark_clock::now() - start).count();
+}
+
+// Function to run the benchmark with a given policy
+void run_policy(const NamedPolicy &p, long long elements, int threads, long long reads) {
+	Vector<int> *v = new Vector<int>(0, p.policy);
+
+	// Fill the vector in batches, so that the time is dominated by the page faults and the writes to the buckets
+	std::vector<int> batch(1 << 16);
+	for(size_t i = 0; i < batch.size(); i++)
+		batch[i] = i;
+	auto t1 = benchmark_clock::now();
+	while(v->size() < elements)
+		v->push_back_n(batch.begin(), batch.begin() + std::min((long long)batch.size(), elements - v->size()));
+	double fill = seconds_since(t1);
+
+	// Scan the whole vector, split across threads on bucket boundaries
+	t1 = benchmark_clock::now();
+	sink = v->reduce(0, [](int a, int b) {return a ^ b;}, threads);
+	double scan = seconds_since(t1);
+
+	// Read random indices, which mostly miss the TLB with small pages
+	unsigned long long seed = 88172645463325252ULL;
+	long long checksum = 0;
+	t1 = benchmark_clock::now();
+	for(long long i = 0; i < reads; i++) {
+		seed ^= seed << 13;
+		seed ^= seed >> 7;
+		seed ^= seed << 17;
+		checksum += v->at(seed % elements)->load(std::memory_order_relaxed);
+	}
+	double random = seconds_since(t1);
+
+	long huge_kb = smaps_kb("AnonHugePages");
+	long rss_kb = smaps_kb("Rss");
+	std::cout << std::left << std::setw(24) << p.name << std::right << std::fixed << std::setprecision(1)
+		<< std::setw(12) << fill * 1000 << std::setw(12) << scan * 1000
+		<< std::setw(14) << elements * sizeof(int) / scan / 1e9
+		<< std::setw(14) << random * 1e9 / reads
+		<< std::setw(14) << rss_kb / 1024 << std::setw(14) << huge_kb / 1024
+		<< std::setw(11) << v->huge_page_fallbacks() << std::endl;
+	sink = checksum;
+	delete v;
+}
+
+// Main function
+int main(int argc, char **argv) {
+	long long elements = 1LL << 26;
+	int threads = 1;
+	long long reads = 10000000;
+	int c;
+	while((c = getopt(argc, argv, "n:t:r:")) != -1) {
+		switch(c) {
+		case 'n': elements = atoll(optarg); break;
+		case 't': threads = atoi(optarg); break;
+		case 'r': reads = atoll(optarg); break;
+		default:
+			std::cerr << "Usage: " << argv[0] << " [-n elements] [-t scan threads] [-r random reads]" << std::endl;
+			return 1;
+		}
+	}
+
+	NamedPolicy policies[] = {
+		{"calloc (default)", BucketPolicy()},
+		{"small pages, prefault", BucketPolicy(BucketPolicy::SMALL_PAGES, BucketPolicy::FIRST_TOUCH, true)},
+		{"transparent huge", BucketPolicy(BucketPolicy::TRANSPARENT_HUGE_PAGES)},
+		{"transparent, prefault", BucketPolicy(BucketPolicy::TRANSPARENT_HUGE_PAGES, BucketPolicy::FIRST_TOUCH, true)},
+		{"explicit huge", BucketPolicy(BucketPolicy::EXPLICIT_HUGE_PAGES)},
+		{"interleave", BucketPolicy(BucketPolicy::SMALL_PAGES, BucketPolicy::INTERLEAVE)},
+		{"interleave, transparent", BucketPolicy(BucketPolicy::TRANSPARENT_HUGE_PAGES, BucketPolicy::INTERLEAVE)},
+	};
+
+	std::cout << elements << " elements, " << threads << " scan threads, " << reads << " random reads" << std::endl;
+	std::cout << std::left << std::setw(24) << "policy" << std::right << std::setw(12) << "fill ms" << std::setw(12) << "scan ms"
+		<< std::setw(14) << "scan GB/s" << std::setw(14) << "random ns" << std::setw(14) << "rss MB" << std::setw(14) << "huge MB"
+		<< std::setw(11) << "fallbacks" << std::endl;
+	for(size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++)
+		run_policy(policies[i], elements, threads, reads);
+	return 0;
+}
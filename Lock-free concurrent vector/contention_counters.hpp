@@ -0,0 +1,122 @@
+
+/*
+ * Per-thread contention counters for the hot paths of the lock-free concurrent vector.
+ */
+
+#ifndef CONTENTION_COUNTERS_HPP
+#define CONTENTION_COUNTERS_HPP
+
+#include <atomic>
+#include <algorithm>
+#include "epoch_manager.hpp"
+
+// Snapshot of a vector's contention counters, summed over all the threads that have used it
+struct VectorStats {
+	// Failed descriptor swaps in push_back()/push_back_n() and pop_back()/pop_back_n()
+	long push_cas_failures;
+	long pop_cas_failures;
+	// Pending writes of other threads that were completed by a helping thread
+	long helped_writes;
+	// Buckets allocated by alloc_bucket() that were freed again because another thread installed the bucket first
+	long bucket_races_lost;
+	// No. of push and pop operations and the no. of times they had to retry
+	long operations;
+	long retries;
+	// Most retries taken by a single operation
+	long max_retries;
+
+	VectorStats() : push_cas_failures(0), pop_cas_failures(0), helped_writes(0), bucket_races_lost(0), operations(0), retries(0),
+		max_retries(0) {}
+
+	// Function to get the average no. of retries per operation
+	double retries_per_operation() const {
+		return operations > 0 ? (double)retries / operations : 0;
+	}
+};
+
+// Contention counters of a vector
+/* Every thread counts into its own slot, indexed by the epoch manager's thread index and padded to its own cache line, so counting
+ * is a relaxed load and store on a line no other thread writes. stats() sums the slots, so a snapshot taken while operations are
+ * running is not atomic across counters. Compiling without -DVECTOR_STATS removes the counters entirely: the class is empty, the
+ * functions that count do nothing and the snapshot is all zeros.
+ */
+class ContentionCounters {
+public:
+	enum Counter {PUSH_CAS_FAILURES, POP_CAS_FAILURES, HELPED_WRITES, BUCKET_RACES_LOST, OPERATIONS, RETRIES, COUNTERS};
+
+#ifdef VECTOR_STATS
+	static const bool enabled = true;
+
+private:
+	struct alignas(64) Slot {
+		std::atomic<long> counts[COUNTERS];
+		std::atomic<long> max_retries;
+	};
+	Slot *slots;
+
+	// Function to get the calling thread's slot
+	Slot &slot() {
+		return slots[EpochManager::instance().thread_index()];
+	}
+
+	// Function to increment a counter that only the calling thread writes
+	static void bump(std::atomic<long> &counter, long n) {
+		counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+
+public:
+	ContentionCounters() {
+		slots = new Slot[EpochManager::MAX_THREADS];
+		for(int i = 0; i < EpochManager::MAX_THREADS; i++) {
+			for(int j = 0; j < COUNTERS; j++)
+				slots[i].counts[j] = 0;
+			slots[i].max_retries = 0;
+		}
+	}
+
+	~ContentionCounters() {
+		delete[] slots;
+	}
+
+	// Function to add to one of the calling thread's counters
+	void add(Counter counter, long n = 1) {
+		if(n != 0)
+			bump(slot().counts[counter], n);
+	}
+
+	// Function to count a completed operation along with the no. of times it had to retry
+	void operation(long retries) {
+		Slot &s = slot();
+		bump(s.counts[OPERATIONS], 1);
+		if(retries == 0)
+			return;
+		bump(s.counts[RETRIES], retries);
+		if(retries > s.max_retries.load(std::memory_order_relaxed))
+			s.max_retries.store(retries, std::memory_order_relaxed);
+	}
+
+	// Function to sum the counters of all the threads
+	VectorStats snapshot() {
+		VectorStats stats;
+		int count = EpochManager::instance().thread_count();
+		for(int i = 0; i < count; i++) {
+			stats.push_cas_failures += slots[i].counts[PUSH_CAS_FAILURES].load(std::memory_order_relaxed);
+			stats.pop_cas_failures += slots[i].counts[POP_CAS_FAILURES].load(std::memory_order_relaxed);
+			stats.helped_writes += slots[i].counts[HELPED_WRITES].load(std::memory_order_relaxed);
+			stats.bucket_races_lost += slots[i].counts[BUCKET_RACES_LOST].load(std::memory_order_relaxed);
+			stats.operations += slots[i].counts[OPERATIONS].load(std::memory_order_relaxed);
+			stats.retries += slots[i].counts[RETRIES].load(std::memory_order_relaxed);
+			stats.max_retries = std::max(stats.max_retries, slots[i].max_retries.load(std::memory_order_relaxed));
+		}
+		return stats;
+	}
+#else
+	static const bool enabled = false;
+
+	void add(Counter, long = 1) {}
+	void operation(long) {}
+	VectorStats snapshot() {return VectorStats();}
+#endif
+};
+
+#endif
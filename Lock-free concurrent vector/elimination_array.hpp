@@ -0,0 +1,109 @@
+
+/*
+ * Elimination array that lets a concurrent push_back() and pop_back() on the lock-free vector exchange an element directly.
+ * Based on the elimination-backoff scheme of Hendler, Shavit and Yerushalmi for lock-free stacks.
+ */
+
+#ifndef ELIMINATION_ARRAY_HPP
+#define ELIMINATION_ARRAY_HPP
+
+#include <atomic>
+#include <cstddef>
+
+// Elimination array for elements of a given stored type
+/* A push that lost the race for the vector's descriptor publishes an offer in a random slot and waits for a short while. A pop that
+ * lost the race looks at a random slot and, if it holds an offer, claims it by swapping it out of the slot. The pair then behaves as
+ * a push_back() immediately followed by a pop_back() of the same element, linearized at the point the offer was claimed, so the
+ * vector itself never sees either operation.
+ */
+template<typename V>
+class EliminationArray {
+
+	static const int WAITING = 0;
+	static const int TAKEN = 1;
+	// No. of times a pushing thread checks its offer before trying to withdraw it
+	static const int SPIN_LIMIT = 256;
+
+	// Offer made by a pushing thread. Each thread has one offer per stored type, which it reuses for every push, and only one
+	// operation per thread can be in flight at a time.
+	struct Offer {
+		V value;
+		std::atomic<int> state;
+	};
+
+	// Slot padded to its own cache line so that exchanges in different slots do not contend
+	struct alignas(64) Slot {
+		std::atomic<Offer *> offer;
+	};
+
+	Slot *slots;
+	int width;
+	// No. of push/pop pairs that exchanged an element through the array
+	std::atomic<long> eliminated;
+
+	// Function to pick a random slot using a thread-local xorshift generator
+	Slot &random_slot() {
+		static thread_local unsigned int seed = 0;
+		if(seed == 0)
+			seed = (unsigned int)(reinterpret_cast<unsigned long>(&seed) >> 4) | 1;
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		return slots[seed % width];
+	}
+
+public:
+	// Public constructor
+	EliminationArray(int w) {
+		width = w;
+		slots = new Slot[width];
+		for(int i = 0; i < width; i++)
+			slots[i].offer = NULL;
+		eliminated = 0;
+	}
+
+	~EliminationArray() {
+		delete[] slots;
+	}
+
+	// Function to offer a value to a concurrent pop. Returns true if a pop took it.
+	bool try_push(const V &value) {
+		static thread_local Offer offer;
+		offer.value = value;
+		offer.state = WAITING;
+		Slot &slot = random_slot();
+		Offer *expected = NULL;
+		if(!slot.offer.compare_exchange_strong(expected, &offer))
+			return false;
+		for(int i = 0; i < SPIN_LIMIT; i++) {
+			if(offer.state == TAKEN)
+				return true;
+		}
+		// Withdraw the offer. If that fails, a pop has already swapped it out of the slot and is about to mark it as taken, so wait
+		// for it to finish reading the value before the offer can be reused.
+		expected = &offer;
+		if(slot.offer.compare_exchange_strong(expected, NULL))
+			return false;
+		while(offer.state != TAKEN);
+		return true;
+	}
+
+	// Function to take a value offered by a concurrent push. Returns true and fills in value if there was an offer to take.
+	bool try_pop(V &value) {
+		Slot &slot = random_slot();
+		Offer *offer = slot.offer.load();
+		if(offer == NULL || !slot.offer.compare_exchange_strong(offer, NULL))
+			return false;
+		value = offer->value;
+		offer->state = TAKEN;
+		eliminated.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Function to get the no. of push/pop pairs that were eliminated
+	long eliminated_count() {
+		return eliminated.load();
+	}
+};
+
+#endif
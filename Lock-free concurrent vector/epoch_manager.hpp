@@ -0,0 +1,216 @@
+
+/*
+ * Epoch-based memory reclamation for the lock-free concurrent vector.
+ */
+
+#ifndef EPOCH_MANAGER_HPP
+#define EPOCH_MANAGER_HPP
+
+#include <iostream>
+#include <atomic>
+#include <vector>
+#include <cstdlib>
+#include "memory_orders.hpp"
+
+// Epoch-based reclamation of the objects that are swapped out of the vector
+/* Threads announce the global epoch they observed before touching any shared descriptor and clear the announcement once their
+ * operation is over. An object retired while the global epoch is e can only still be referenced by threads that announced e or an
+ * earlier epoch, and the global epoch only advances once every active thread has announced the current one. So by the time the
+ * epoch reaches e+2, none of those threads can be running anymore and the object can be freed.
+ */
+class EpochManager {
+public:
+	static const int MAX_THREADS = 512;
+
+private:
+	// Number of retired objects a thread collects before trying to advance the epoch and free them
+	static const int RETIRE_THRESHOLD = 128;
+
+	// Object retired by a thread along with the function to free it and the epoch it was retired in
+	struct Retired {
+		void *object;
+		void (*deleter)(void *);
+		unsigned long epoch;
+	};
+
+	// Per-thread record. Each record sits on its own cache line so that announcing an epoch does not invalidate the other threads'
+	// records. A record is handed back when its thread exits and any objects it could not free yet are left to the next owner.
+	struct alignas(64) ThreadRecord {
+		std::atomic<bool> in_use;
+		// (epoch << 1) | 1 while the thread is inside an operation, 0 otherwise
+		std::atomic<unsigned long> announced;
+		std::atomic<long> pending;
+		int nesting;
+		// Size the retired list must reach before the next collection, so that a thread stalled inside an old epoch does not
+		// make every retire() rescan a list that cannot shrink
+		size_t next_collect;
+		std::vector<Retired> retired;
+	};
+
+	// Releases the calling thread's record when the thread exits
+	struct RecordHolder {
+		ThreadRecord *record;
+		~RecordHolder() {
+			if(record != NULL)
+				EpochManager::instance().release_record(record);
+		}
+	};
+
+	std::atomic<unsigned long> global_epoch;
+	// No. of records that have ever been handed out, so that scans can stop early
+	std::atomic<int> record_count;
+	ThreadRecord records[MAX_THREADS];
+
+	EpochManager() {
+		global_epoch = 0;
+		record_count = 0;
+		for(int i = 0; i < MAX_THREADS; i++) {
+			records[i].in_use = false;
+			records[i].announced = 0;
+			records[i].pending = 0;
+			records[i].nesting = 0;
+			records[i].next_collect = RETIRE_THRESHOLD;
+		}
+	}
+
+	// Function to get the calling thread's record, claiming a free one on first use
+	ThreadRecord *get_record() {
+		static thread_local RecordHolder holder = {NULL};
+		if(holder.record == NULL)
+			holder.record = acquire_record();
+		return holder.record;
+	}
+
+	// Function to claim a free record
+	ThreadRecord *acquire_record() {
+		for(int i = 0; i < MAX_THREADS; i++) {
+			bool expected = false;
+			if(!records[i].in_use && records[i].in_use.compare_exchange_strong(expected, true)) {
+				int count = record_count;
+				while(count < i + 1 && !record_count.compare_exchange_weak(count, i + 1));
+				return &records[i];
+			}
+		}
+		std::cerr << "EpochManager: more than " << MAX_THREADS << " threads are using the vector" << std::endl;
+		std::abort();
+	}
+
+	// Function to hand a record back when its thread exits
+	void release_record(ThreadRecord *record) {
+		try_advance();
+		collect(record);
+		record->in_use = false;
+	}
+
+	// Function to advance the global epoch if every active thread has announced the current one
+	bool try_advance() {
+		unsigned long current = global_epoch;
+		int count = record_count;
+		for(int i = 0; i < count; i++) {
+			unsigned long announced = records[i].announced;
+			if((announced & 1) && (announced >> 1) != current)
+				return false;
+		}
+		return global_epoch.compare_exchange_strong(current, current + 1);
+	}
+
+	// Function to free the objects in a record that no thread can reference anymore
+	void collect(ThreadRecord *record) {
+		unsigned long current = global_epoch;
+		size_t kept = 0;
+		for(size_t i = 0; i < record->retired.size(); i++) {
+			if(record->retired[i].epoch + 2 <= current)
+				record->retired[i].deleter(record->retired[i].object);
+			else
+				record->retired[kept++] = record->retired[i];
+		}
+		record->retired.resize(kept);
+		record->pending = kept;
+		record->next_collect = kept + RETIRE_THRESHOLD;
+	}
+
+public:
+	~EpochManager() {
+		// No other threads are running by the time the static objects are destroyed
+		for(int i = 0; i < MAX_THREADS; i++) {
+			for(size_t j = 0; j < records[i].retired.size(); j++)
+				records[i].retired[j].deleter(records[i].retired[j].object);
+		}
+	}
+
+	// Function to get the single instance shared by all vectors
+	static EpochManager &instance() {
+		static EpochManager manager;
+		return manager;
+	}
+
+	// Function to get the index of the calling thread's record, which is unique among the running threads
+	int thread_index() {
+		return get_record() - records;
+	}
+
+	// Function to get an upper bound on the thread indices handed out so far
+	int thread_count() {
+		return record_count;
+	}
+
+	// Function to mark the start of an operation. Calls can be nested.
+	/* The fence orders the announcement before every load the operation makes, including loads with acquire, which could otherwise
+	 * be satisfied before the announcement is visible. Paired with the seq_cst swap that takes an object out of the vector, it
+	 * ensures that either this thread sees the swap, or the epoch manager sees this thread's announcement.
+	 */
+	void enter() {
+		ThreadRecord *record = get_record();
+		if(record->nesting++ == 0) {
+			record->announced.store((global_epoch.load() << 1) | 1, VECTOR_ORDER(relaxed));
+			std::atomic_thread_fence(VECTOR_ORDER(seq_cst));
+		}
+	}
+
+	// Function to mark the end of an operation
+	// Release keeps every access of the operation before the announcement is cleared.
+	void exit() {
+		ThreadRecord *record = get_record();
+		if(--record->nesting == 0)
+			record->announced.store(0, VECTOR_ORDER(release));
+	}
+
+	// Function to schedule an object, which is no longer reachable from the vector, to be freed once it is safe to do so
+	void retire(void *object, void (*deleter)(void *)) {
+		ThreadRecord *record = get_record();
+		Retired r = {object, deleter, global_epoch.load()};
+		record->retired.push_back(r);
+		record->pending = record->retired.size();
+		if(record->retired.size() >= record->next_collect) {
+			try_advance();
+			collect(record);
+		}
+	}
+
+	// Function to free the calling thread's retired objects right away if no other thread is inside an operation
+	// Must be called outside of any operation, as the calling thread's own epoch would hold the objects back.
+	void reclaim() {
+		ThreadRecord *record = get_record();
+		for(int i = 0; i < 2; i++)
+			try_advance();
+		collect(record);
+	}
+
+	// Function to get the no. of retired objects that are still waiting to be freed
+	long pending() {
+		long total = 0;
+		int count = record_count;
+		for(int i = 0; i < count; i++)
+			total += records[i].pending;
+		return total;
+	}
+};
+
+// Guard object that keeps the calling thread inside an epoch for as long as it is in scope
+class EpochGuard {
+public:
+	EpochGuard() {EpochManager::instance().enter();}
+	~EpochGuard() {EpochManager::instance().exit();}
+};
+
+#endif
@@ -0,0 +1,89 @@
+
+/*
+ * Log-linear latency histogram used by the benchmark harness.
+ */
+
+#ifndef LATENCY_HISTOGRAM_HPP
+#define LATENCY_HISTOGRAM_HPP
+
+#include <cstdint>
+#include <cstring>
+
+// Histogram of latencies in nanoseconds
+/* Values are grouped by their highest set bit and each power of 2 is split into SUB_BUCKETS linear sub-buckets, which keeps the
+ * relative error of a percentile under 1/SUB_BUCKETS while recording is just a couple of shifts and an increment. Each thread keeps
+ * its own histogram and they are merged once the run is over.
+ */
+class LatencyHistogram {
+
+	static const int SUB_BUCKET_BITS = 4;
+	static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	static const int BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+	uint64_t counts[BUCKETS];
+	uint64_t total;
+
+	// Function to get the bucket of a value
+	static int bucket_of(uint64_t value) {
+		if(value < SUB_BUCKETS)
+			return value;
+		int hibit = 63 - __builtin_clzll(value);
+		int sub_bucket = (value >> (hibit - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+		return (hibit - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub_bucket;
+	}
+
+	// Function to get the smallest value that falls in a bucket
+	static uint64_t lower_bound(int bucket) {
+		if(bucket < SUB_BUCKETS)
+			return bucket;
+		int hibit = bucket / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+		return ((uint64_t)SUB_BUCKETS + bucket % SUB_BUCKETS) << (hibit - SUB_BUCKET_BITS);
+	}
+
+public:
+	LatencyHistogram() {
+		clear();
+	}
+
+	void clear() {
+		memset(counts, 0, sizeof(counts));
+		total = 0;
+	}
+
+	// Function to record a latency
+	void record(uint64_t nanoseconds) {
+		counts[bucket_of(nanoseconds)]++;
+		total++;
+	}
+
+	// Function to add the counts of another histogram to this one
+	void merge(const LatencyHistogram &other) {
+		for(int i = 0; i < BUCKETS; i++)
+			counts[i] += other.counts[i];
+		total += other.total;
+	}
+
+	// Function to get the no. of recorded latencies
+	uint64_t count() const {
+		return total;
+	}
+
+	// Function to get the latency below which the given fraction of the recorded latencies fall
+	// The midpoint of the bucket holding the percentile is returned, 0 if nothing was recorded.
+	uint64_t percentile(double fraction) const {
+		if(total == 0)
+			return 0;
+		uint64_t rank = fraction * total;
+		if(rank >= total)
+			rank = total - 1;
+		uint64_t seen = 0;
+		for(int i = 0; i < BUCKETS; i++) {
+			seen += counts[i];
+			if(seen > rank)
+				return (lower_bound(i) + (i + 1 < BUCKETS ? lower_bound(i + 1) : lower_bound(i))) / 2;
+		}
+		return lower_bound(BUCKETS - 1);
+	}
+};
+
+#endif
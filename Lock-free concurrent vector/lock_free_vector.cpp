@@ -1,262 +1,541 @@
-
 /*
- * Lock-free concurrent vector (dynamically resizable array) implementation in C++.
+ * Benchmark harness for the lock-free concurrent vector (dynamically resizable array) implementation in C++.
  * @author: ArvindRS
  * @date: 11/21/2017
  */
 
 #include <iostream>
-#include <atomic>
-#include <pthread.h>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
 #include <cmath>
+#include <pthread.h>
+#include <sched.h>
 #include <chrono>
+#include <fstream>
+#include <getopt.h>
+#include <unistd.h>
+#include "lock_free_vector.hpp"
+#include "latency_histogram.hpp"
 
-// Object to specify the write operation details for the helping thread
-class WriteDesc {
-public:
-	bool pending;
-	int old_value;
-	int position;
-	int new_value;
-	WriteDesc(int nv, int ov, int pos) {
-		new_value = nv;
-		old_value = ov;
-		position = pos;
-		pending = true;
-	}
+typedef std::chrono::steady_clock benchmark_clock;
+
+// Structure to hold the benchmark configuration given on the command line
+struct BenchmarkConfig {
+	int min_threads;
+	int max_threads;
+	// Threads are doubled from min_threads up to max_threads, unless a linear step is given
+	int thread_step;
+	long ops_per_thread;
+	// Duration of a run in seconds. If non-zero, it replaces ops_per_thread.
+	double duration;
+	// Fraction of the operations that are pushes
+	double push_ratio;
+	// If set, every thread mixes pushes and pops at push_ratio. Otherwise push_ratio of the threads only push and the rest only pop.
+	bool mixed;
+	int batch_size;
+	int elimination_width;
+	long prefill;
+	int repetitions;
+	// Every latency_sample-th operation is timed, 0 disables latency measurements
+	int latency_sample;
+	bool pin_threads;
+	// If set, every run checks that each element pushed was either popped exactly once or is still in the vector
+	bool verify;
+	std::string format;
+};
+
+// Structure to pass on multiple parameters to the threaded function
+struct MyArguments {
+	int data;
+	int cpu;
+	long execution_limit;
+	// 0 to push, 1 to pop, 2 to mix both at push_ratio
+	int operation;
+	double push_ratio;
+	int batch_size;
+	int latency_sample;
+	Vector<int> *vector;
+	// Start barrier and stop flag shared by all the threads of a run
+	std::atomic<int> *ready;
+	std::atomic<bool> *go;
+	std::atomic<bool> *stop;
+	bool verify;
+	// Results
+	long completed;
+	long empty_pops;
+	// Elements pushed, and elements popped counted by the thread that pushed them, when verifying
+	long pushed;
+	std::vector<long> popped;
+	benchmark_clock::time_point finish;
+	LatencyHistogram latencies;
 };
 
-// Object to specify the pending write operation
-class Descriptor {
-public:
-	std::atomic<int> size;
-	WriteDesc *write_op;
-	Descriptor(int s, WriteDesc *w){size = s,write_op = w;}
+// Structure to hold the results of a single run
+struct RunResult {
+	double seconds;
+	long operations;
+	long empty_pops;
+	double ops_per_second;
+	long final_size;
+	long eliminated;
+	long resident_memory_kb;
+	long pending_reclamation;
+	long heap_allocations;
+	// No. of pushing threads whose elements were lost or duplicated, -1 if the run was not verified
+	long verify_errors;
+	// Contention counters of the run's vector, all zero unless compiled with -DVECTOR_STATS
+	VectorStats stats;
+	LatencyHistogram latencies;
 };
 
-// Lock-free vector class implementation
-class Vector {
-
-	// 2-level array of atomic variables
-	typedef std::atomic<int> location;
-	std::atomic<location *> memory[32];
-	// Pointer to a descriptor object
-	std::atomic<Descriptor *> descriptor;
-	// Variable to specify the initial size of the array
-	int first_bucket_size;
-
-public:
-	// Public constructor
-	Vector() {
-		Descriptor *temp = new Descriptor(0, NULL);
-		descriptor = temp;
-		first_bucket_size = 2;
-		std::atomic<int> *array = new std::atomic<int>[first_bucket_size];
-		memory[0] = array;
+// Function to count a popped element against the thread that pushed it
+// Every thread pushes its own index, so an element that is out of range was never pushed and is counted against no thread.
+inline void count_popped(MyArguments *args, int value) {
+	if(value >= 0 && value < (int)args->popped.size())
+		args->popped[value]++;
+}
+
+// Function to perform a single operation, or a batch of them, and return the no. of elements it covered
+inline long perform(Vector<int> &v, MyArguments *args, bool push, std::vector<int> &batch) {
+	if(args->batch_size <= 1) {
+		if(push) {
+			v.push_back(args->data);
+			if(args->verify)
+				args->pushed++;
+			return 1;
+		}
+		std::optional<int> value = v.pop_back();
+		if(!value)
+			args->empty_pops++;
+		else if(args->verify)
+			count_popped(args, *value);
+		return 1;
 	}
-	
-	// Function to return the current size of arraylist
-	int size() {
-		Descriptor *current_descriptor = descriptor.load();
-		if(current_descriptor->write_op != NULL && current_descriptor->write_op->pending)
-			return current_descriptor->size - 1;
-		return current_descriptor->size;
+	// Push or pop the elements in bursts of batch_size, each with a single descriptor swap
+	if(push) {
+		// The batch buffer is shared with pops, so it may hold elements of other threads by now
+		if(args->verify) {
+			std::fill(batch.begin(), batch.end(), args->data);
+			args->pushed += args->batch_size;
+		}
+		v.push_back_n(batch.begin(), batch.end());
+		return args->batch_size;
 	}
-
-	// Function to get the position at a given index in the arraylist
-	std::atomic<int>* at(int i) {
-		int pos = i + first_bucket_size;
-		int hibit = highest_bit(pos);
-		int index = pos ^ (int)std::pow(2, hibit);
-		return &memory[hibit - highest_bit(first_bucket_size)][index];
+	long count = v.pop_back_n(batch.begin(), args->batch_size);
+	if(count == 0)
+		args->empty_pops++;
+	else if(args->verify) {
+		for(long i = 0; i < count; i++)
+			count_popped(args, batch[i]);
 	}
+	// A pop may find fewer elements than the batch asked for, and only those count towards the throughput
+	return count;
+}
 
-	// Function to get the highest set bit in a given integer
-	int highest_bit(int num) {
-		if(!num) return 0;
-		return 31 - __builtin_clz(num);
-	}
+// Function to run the thread code
+void *run(void *ptr) {
 
+	// Get the arguments
+	struct MyArguments *args = (MyArguments *)ptr;
+	Vector<int> &v = *args->vector;
+	std::vector<int> batch(args->batch_size, args->data);
+	unsigned int seed = args->data * 2654435761u + 1;
+	long sample = args->latency_sample;
+	long limit = args->execution_limit;
 
-	// Function to push an element to the back of the vector
-	void push_back(int data) {
-		Descriptor *local_descriptor = descriptor.load();
-		WriteDesc *write_op = new WriteDesc(data, 0, local_descriptor->size);
-		Descriptor *new_descriptor = new Descriptor(local_descriptor->size + 1, write_op);
-		do {
-			local_descriptor = descriptor.load();
-			// Take a local copy of the vector's descriptor and attempt to finish any pending writes before continuing with current
-			// write operation.
-			complete_write(local_descriptor->write_op);
-			int bucket = highest_bit(local_descriptor->size + first_bucket_size) - highest_bit(first_bucket_size);
-			// If the current bucket is full, allocate a new bucket twice the current size
-			if(memory[bucket] == NULL)
-				alloc_bucket(bucket);
-			// Create a new write operation object that describes the details of the write operation to be performed and a new 
-			// descriptor object which holds a reference to the write operation object and the new size of the vector
-			write_op = new WriteDesc(data, 0, local_descriptor->size);
-			new_descriptor = new Descriptor(local_descriptor->size + 1, write_op);
-			// The following compare_exchange_weak() is the linearization point for the push_back() operation, with respect to the other 
-			// push and pop operations.
-			// If the thread fails to atomically swap the vector object's descriptor with it's descriptor object, then another thread has 
-			// changed the state of the vector since the current thread obtained a local copy of the vector' descriptor and thus, has
-			// to redo the entire process again.
-		} while(!descriptor.compare_exchange_weak(local_descriptor,new_descriptor));
-		complete_write(new_descriptor->write_op);
-	}
+	// Wait at the start barrier, so that thread creation is not part of the timed region
+	args->ready->fetch_add(1);
+	while(!args->go->load());
 
-	// Function to complete any pending writes
-	void complete_write(WriteDesc *writeop) {
-		// Skip if the pending is false for the write operation or it's NULL
-		if(writeop != NULL && writeop->pending) {
-			int pos = writeop->position + first_bucket_size;
-			int hibit = highest_bit(pos);
-			int index = pos ^ (int)std::pow(2, hibit);
-			int old_value = memory[hibit - highest_bit(first_bucket_size)][index];
-			// We atomically swap the old value, which is usually NULL, with the new value to be written and then mark the write operation
-			// as complete by setting the pending flag to false
-			memory[hibit - highest_bit(first_bucket_size)][index].compare_exchange_strong(old_value, writeop->new_value);
-			writeop->pending = false;
+	// Perform the operations until the limit is reached or the run is stopped. The limit counts the elements asked for rather than
+	// the ones covered, so that a thread popping from an empty vector still finishes.
+	long done = 0;
+	for(long i = 0; limit == 0 || i * args->batch_size < limit; i++) {
+		if(limit == 0 && args->stop->load(std::memory_order_relaxed))
+			break;
+		bool push = args->operation == 0;
+		if(args->operation == 2) {
+			seed ^= seed << 13;
+			seed ^= seed >> 17;
+			seed ^= seed << 5;
+			push = (seed % 10000) < args->push_ratio * 10000;
 		}
+		if(sample != 0 && i % sample == 0) {
+			auto t1 = benchmark_clock::now();
+			done += perform(v, args, push, batch);
+			auto t2 = benchmark_clock::now();
+			args->latencies.record(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+		}
+		else
+			done += perform(v, args, push, batch);
 	}
+	args->completed = done;
+	args->finish = benchmark_clock::now();
+	return NULL;
+}
 
-	// Function to allocate a new bucket
-	void alloc_bucket(int bucket) {
-		long long new_bucket_size = std::pow(first_bucket_size,bucket+1);
-		// For some strange reason, we need to copy the atomic object to a local variable before applying CAS
-		// Else, you get this error;
-		// error: invalid initialization of non-const reference of type ‘std::__atomic_base<int>::__int_type& {aka int&}’ 
-		// from an rvalue of type ‘std::__atomic_base<int>::__int_type {aka int}’
-		std::atomic<int> *temp_memory = memory[bucket];
-		std::atomic<int> *array = new std::atomic<int>[new_bucket_size];
-		if(!memory[bucket].compare_exchange_strong(temp_memory, array)) {
-			delete array;
-		}
+// Function to get the resident set size of the process in kilobytes
+long resident_memory_kb() {
+	std::ifstream statm("/proc/self/statm");
+	long total_pages = 0, resident_pages = 0;
+	if(!(statm >> total_pages >> resident_pages))
+		return -1;
+	return resident_pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// Function to get the no. of descriptors, write operations and batch arrays that had to be allocated from the heap rather than a
+// thread's pool
+long descriptor_heap_allocations() {
+	return ObjectPool<Descriptor<int> >::heap_allocations() + ObjectPool<WriteDesc<int> >::heap_allocations() +
+		ArrayPool<int>::heap_allocations();
+}
+
+// Function to check that no element of a run was lost or duplicated, returning the no. of pushing threads whose elements were
+/* Each thread's elements are identical, so they are checked by count: the elements a thread pushed must equal the ones popped by
+ * any thread plus the ones left in the vector. The counts include the extra thread that stands for the prefilled elements.
+ */
+long verify(Vector<int> &v, std::vector<MyArguments> &args, long prefill) {
+	int threads = args.size();
+	std::vector<long> balance(threads + 1, 0);
+	for(int i = 0; i < threads; i++)
+		balance[i] += args[i].pushed;
+	balance[threads] += prefill;
+	for(int i = 0; i < threads; i++) {
+		for(int j = 0; j <= threads; j++)
+			balance[j] -= args[i].popped[j];
 	}
+	long unknown = 0;
+	v.for_each([&](int value) {
+		if(value >= 0 && value <= threads)
+			balance[value]--;
+		else
+			unknown++;
+	});
+	long errors = unknown > 0 ? 1 : 0;
+	for(int i = 0; i <= threads; i++) {
+		if(balance[i] != 0)
+			errors++;
+	}
+	return errors;
+}
+
+// Function implementing a single run of the benchmark
+RunResult run_test(const BenchmarkConfig &config, int thread_count) {
+
+	// Every run gets its own vector, so that runs do not influence each other. When verifying, the prefilled elements are counted
+	// as pushed by an extra thread past the last one.
+	Vector<int> v(config.elimination_width);
+	for(long i = 0; i < config.prefill; i++)
+		v.push_back(config.verify ? thread_count : i);
+
+	// Used to split the threads into pushers and poppers
+	int split_count = std::lround(thread_count * config.push_ratio);
+	long execution_limit = config.duration > 0 ? 0 : config.ops_per_thread;
+
+	std::vector<pthread_t> thread(thread_count);
+	std::vector<MyArguments> args(thread_count);
+	std::atomic<int> ready(0);
+	std::atomic<bool> go(false), stop(false);
+	long nprocs = sysconf(_SC_NPROCESSORS_ONLN);
+	long allocations_before = descriptor_heap_allocations();
 
-	// Function to display the contents of the vector
-	void display() {
-		Descriptor *local_descriptor = descriptor;
-		for(int i = 0; i < local_descriptor->size; i++) {
-			int pos = i + first_bucket_size;
-			int hibit = highest_bit(pos);
-			int index = pos ^ (int)std::pow(2, hibit);
-			std::cout << memory[hibit - highest_bit(first_bucket_size)][index] << " ";
+	// Create the threads. They wait at the start barrier until all of them are running.
+	for(int i = 0; i < thread_count; i++) {
+		args[i].data = i;
+		args[i].cpu = i % nprocs;
+		args[i].execution_limit = execution_limit;
+		args[i].operation = config.mixed ? 2 : (i < split_count ? 0 : 1);
+		args[i].push_ratio = config.push_ratio;
+		args[i].batch_size = config.batch_size;
+		args[i].latency_sample = config.latency_sample;
+		args[i].vector = &v;
+		args[i].ready = &ready;
+		args[i].go = &go;
+		args[i].stop = &stop;
+		args[i].verify = config.verify;
+		args[i].completed = 0;
+		args[i].empty_pops = 0;
+		args[i].pushed = 0;
+		args[i].popped.assign(config.verify ? thread_count + 1 : 0, 0);
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+		if(config.pin_threads) {
+			cpu_set_t cpus;
+			CPU_ZERO(&cpus);
+			CPU_SET(args[i].cpu, &cpus);
+			pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
 		}
-		std::cout << std::endl;
+		pthread_create(&thread[i], &attr, run, (void *)&args[i]);
+		pthread_attr_destroy(&attr);
 	}
+	while(ready.load() < thread_count)
+		sched_yield();
 
-	// Function to pop an element from the back of the arraylist
-	// The pop_back() operation uses a similar helping approach as the push_back() operation by completing any pending writes before 
-	// popping the element and swapping in a new descriptor with size-1. 
-	int pop_back() {
-		Descriptor *local_descriptor = descriptor;
-		if(local_descriptor->size == 0) return -1;
-		Descriptor *new_descriptor = new Descriptor(local_descriptor->size-1,NULL);
-		int data = *at(local_descriptor->size-1);
-		do {
-			local_descriptor = descriptor;
-			complete_write(local_descriptor->write_op);
-			data = *at(local_descriptor->size-1);
-			new_descriptor = new Descriptor(local_descriptor->size-1,NULL);
-			// The following compare_exchange_weak() is the linearization point for the pop_back() operation with respect to the other
-			// push and pop operations. If this atomic swap failed, then that means another another had changed the state of the vector
-			// since the time the current thread obtained a local copy of the vector's descriptor.
-		} while(!descriptor.compare_exchange_weak(local_descriptor, new_descriptor));
-		return data;
+	// Release the threads and start timing the execution time
+	auto t1 = benchmark_clock::now();
+	go = true;
+	if(config.duration > 0) {
+		usleep((useconds_t)(config.duration * 1e6));
+		stop = true;
 	}
 
-	// Function to check if the arraylist is empty
-	/* This function is wait-free as we can define the linearization point as the point at which the local copy of the descriptor 
-	 * is successfully compared to the value 0.
-	 */
-	bool isEmpty() {
-		Descriptor *local_descriptor = descriptor;
-		return local_descriptor->size == 0;
+	// Wait for the threads to complete. The run ends when the last thread finishes its operations.
+	RunResult result;
+	result.operations = 0;
+	result.empty_pops = 0;
+	auto t2 = t1;
+	for(int i = 0; i < thread_count; i++) {
+		pthread_join(thread[i], NULL);
+		result.operations += args[i].completed;
+		result.empty_pops += args[i].empty_pops;
+		result.latencies.merge(args[i].latencies);
+		if(args[i].finish > t2)
+			t2 = args[i].finish;
 	}
-};
-
+	result.seconds = std::chrono::duration<double>(t2 - t1).count();
+	result.ops_per_second = result.seconds > 0 ? result.operations / result.seconds : 0;
+	result.final_size = v.size();
+	result.eliminated = v.eliminated_count();
+	result.resident_memory_kb = resident_memory_kb();
+	result.pending_reclamation = EpochManager::instance().pending();
+	result.heap_allocations = descriptor_heap_allocations() - allocations_before;
+	result.stats = v.stats();
+	result.verify_errors = config.verify ? verify(v, args, config.prefill) : -1;
+	return result;
+}
 
-// Structure to pass on multiple parameters to the threaded function
-struct MyArguments {
-	int data;
-	int execution_limit;
-	int operation;
+// Structure to hold the results of all the repetitions of a configuration
+struct Summary {
+	int threads;
+	double mean_ops_per_second;
+	double stddev_ops_per_second;
+	double min_ops_per_second;
+	double max_ops_per_second;
+	LatencyHistogram latencies;
+	std::vector<RunResult> runs;
 };
 
-// Global Vector object
-Vector v;
+// Function to aggregate the repetitions of a configuration
+Summary summarize(int threads, const std::vector<RunResult> &runs) {
+	Summary s;
+	s.threads = threads;
+	s.runs = runs;
+	double sum = 0, squares = 0;
+	s.min_ops_per_second = runs[0].ops_per_second;
+	s.max_ops_per_second = runs[0].ops_per_second;
+	for(size_t i = 0; i < runs.size(); i++) {
+		sum += runs[i].ops_per_second;
+		s.min_ops_per_second = std::min(s.min_ops_per_second, runs[i].ops_per_second);
+		s.max_ops_per_second = std::max(s.max_ops_per_second, runs[i].ops_per_second);
+		s.latencies.merge(runs[i].latencies);
+	}
+	s.mean_ops_per_second = sum / runs.size();
+	for(size_t i = 0; i < runs.size(); i++)
+		squares += (runs[i].ops_per_second - s.mean_ops_per_second) * (runs[i].ops_per_second - s.mean_ops_per_second);
+	s.stddev_ops_per_second = runs.size() > 1 ? std::sqrt(squares / (runs.size() - 1)) : 0;
+	return s;
+}
 
-// Function to run the thread code
-void *run(void *ptr) {
-	
-	// Get the arguments
-	struct MyArguments *args = (MyArguments *)ptr;
-	int data = args->data;
-	long int execution_limit = args->execution_limit;
-	int operation = args->operation;
-
-	// Perform the operations for the given number of times
-	for(int i = 1; i <= execution_limit; i++) {
-		if(operation == 0)
-			v.push_back(data);
-		else
-			v.pop_back();
+// Functions to display the results in the requested format
+void print_text(const BenchmarkConfig &config, const Summary &s) {
+	std::cout << "no. of threads = " << s.threads << std::endl;
+	std::cout << "push ratio = " << config.push_ratio << (config.mixed ? " (mixed per operation)" : " (split by thread)") << std::endl;
+	std::cout << "batch size = " << config.batch_size << std::endl;
+	for(size_t i = 0; i < s.runs.size(); i++) {
+		const RunResult &r = s.runs[i];
+		std::cout << "run " << i + 1 << ": " << r.operations << " operations in " << r.seconds * 1000 << " milliseconds, "
+			<< (long)r.ops_per_second << " ops/sec, " << r.empty_pops << " empty pops, vector size = " << r.final_size
+			<< ", eliminated push/pop pairs = " << r.eliminated << ", resident memory = " << r.resident_memory_kb << " KB"
+			<< ", descriptors awaiting reclamation = " << r.pending_reclamation
+			<< ", descriptor heap allocations = " << r.heap_allocations << std::endl;
+		if(r.verify_errors >= 0)
+			std::cout << "       verification " << (r.verify_errors == 0 ? "passed" : "FAILED") << ": " << r.verify_errors
+				<< " threads with lost or duplicated elements" << std::endl;
+		if(ContentionCounters::enabled)
+			std::cout << "       push CAS failures = " << r.stats.push_cas_failures << ", pop CAS failures = " << r.stats.pop_cas_failures
+				<< ", helped writes = " << r.stats.helped_writes << ", bucket races lost = " << r.stats.bucket_races_lost
+				<< ", retries per operation = " << r.stats.retries_per_operation() << " (max " << r.stats.max_retries << ")" << std::endl;
 	}
+	std::cout << "throughput = " << (long)s.mean_ops_per_second << " ops/sec (stddev " << (long)s.stddev_ops_per_second
+		<< ", min " << (long)s.min_ops_per_second << ", max " << (long)s.max_ops_per_second << ")" << std::endl;
+	if(s.latencies.count() > 0)
+		std::cout << "latency p50 = " << s.latencies.percentile(0.5) << " ns, p99 = " << s.latencies.percentile(0.99)
+			<< " ns, p99.9 = " << s.latencies.percentile(0.999) << " ns" << std::endl;
+	std::cout << std::endl;
 }
 
+void print_csv_header() {
+	std::cout << "threads,push_ratio,mixed,batch_size,elimination_width,run,operations,seconds,ops_per_sec,empty_pops,"
+		"final_size,eliminated,resident_kb,pending_reclamation,heap_allocations,p50_ns,p99_ns,p999_ns,verify_errors";
+	if(ContentionCounters::enabled)
+		std::cout << ",push_cas_failures,pop_cas_failures,helped_writes,bucket_races_lost,retries_per_op,max_retries";
+	std::cout << std::endl;
+}
 
-// Function implementing the test framework
-void run_test(int thread_count, int limit, float split_r) {
+void print_csv(const BenchmarkConfig &config, const Summary &s) {
+	for(size_t i = 0; i < s.runs.size(); i++) {
+		const RunResult &r = s.runs[i];
+		std::cout << s.threads << "," << config.push_ratio << "," << config.mixed << "," << config.batch_size << ","
+			<< config.elimination_width << "," << i + 1 << "," << r.operations << "," << r.seconds << "," << r.ops_per_second << ","
+			<< r.empty_pops << "," << r.final_size << "," << r.eliminated << "," << r.resident_memory_kb << ","
+			<< r.pending_reclamation << "," << r.heap_allocations << "," << r.latencies.percentile(0.5) << ","
+			<< r.latencies.percentile(0.99) << "," << r.latencies.percentile(0.999) << "," << r.verify_errors;
+		if(ContentionCounters::enabled)
+			std::cout << "," << r.stats.push_cas_failures << "," << r.stats.pop_cas_failures << "," << r.stats.helped_writes << ","
+				<< r.stats.bucket_races_lost << "," << r.stats.retries_per_operation() << "," << r.stats.max_retries;
+		std::cout << std::endl;
+	}
+}
 
-	// Initialize variables
-	int execution_limit = limit;
+void print_json(const BenchmarkConfig &config, const Summary &s, bool first) {
+	std::cout << (first ? "[\n" : ",\n") << "  {\"threads\": " << s.threads << ", \"push_ratio\": " << config.push_ratio
+		<< ", \"mixed\": " << (config.mixed ? "true" : "false") << ", \"batch_size\": " << config.batch_size
+		<< ", \"elimination_width\": " << config.elimination_width
+		<< ", \"ops_per_sec\": {\"mean\": " << s.mean_ops_per_second << ", \"stddev\": " << s.stddev_ops_per_second
+		<< ", \"min\": " << s.min_ops_per_second << ", \"max\": " << s.max_ops_per_second << "}"
+		<< ", \"latency_ns\": {\"p50\": " << s.latencies.percentile(0.5) << ", \"p99\": " << s.latencies.percentile(0.99)
+		<< ", \"p999\": " << s.latencies.percentile(0.999) << "}, \"runs\": [";
+	for(size_t i = 0; i < s.runs.size(); i++) {
+		const RunResult &r = s.runs[i];
+		std::cout << (i ? ", " : "") << "{\"operations\": " << r.operations << ", \"seconds\": " << r.seconds
+			<< ", \"ops_per_sec\": " << r.ops_per_second << ", \"empty_pops\": " << r.empty_pops
+			<< ", \"final_size\": " << r.final_size << ", \"eliminated\": " << r.eliminated
+			<< ", \"resident_kb\": " << r.resident_memory_kb << ", \"pending_reclamation\": " << r.pending_reclamation
+			<< ", \"heap_allocations\": " << r.heap_allocations << ", \"verify_errors\": " << r.verify_errors;
+		if(ContentionCounters::enabled)
+			std::cout << ", \"push_cas_failures\": " << r.stats.push_cas_failures << ", \"pop_cas_failures\": " << r.stats.pop_cas_failures
+				<< ", \"helped_writes\": " << r.stats.helped_writes << ", \"bucket_races_lost\": " << r.stats.bucket_races_lost
+				<< ", \"retries_per_op\": " << r.stats.retries_per_operation() << ", \"max_retries\": " << r.stats.max_retries;
+		std::cout << "}";
+	}
+	std::cout << "]}";
+}
 
-	// Used to split the threads into pushers and poppers
-	float split_ratio = split_r;
-	int split_count = thread_count * split_ratio;
-	
-	// Create the threads
-	pthread_t thread[thread_count];
+// Function to display the command line options
+void usage(const char *program) {
+	std::cerr << "Usage: " << program << " [options]\n"
+		"  -t, --threads MIN[-MAX]    thread counts to run, doubling from MIN to MAX (default 8)\n"
+		"  -s, --thread-step N        step through the thread counts linearly by N instead of doubling\n"
+		"  -n, --ops N                operations per thread (default 500000)\n"
+		"  -d, --duration SECONDS     run for a fixed time instead of a fixed no. of operations\n"
+		"  -p, --push-ratio R         fraction of pushes, 0 to 1 (default 0.5)\n"
+		"  -m, --mixed                mix pushes and pops in every thread instead of splitting the threads\n"
+		"  -b, --batch N              push and pop in batches of N elements (default 1)\n"
+		"  -e, --elimination W        put an elimination array of W slots in front of the vector (default 0, disabled)\n"
+		"  -f, --prefill N            push N elements before the run starts (default 0)\n"
+		"  -r, --repeat N             repeat every configuration N times (default 3)\n"
+		"  -l, --latency-sample N     time every N-th operation, 0 to disable (default 1)\n"
+		"  -P, --pin                  pin thread i to cpu i modulo the no. of cpus\n"
+		"  -V, --verify               check that no element is lost or duplicated, exit with 2 if any run fails\n"
+		"  -o, --format FORMAT        text, csv or json (default text)\n";
+}
 
-	// Create an arguments structure to pass on the arguments to the threads
-	struct MyArguments args[thread_count];
+// Function to parse the command line into a configuration
+bool parse_arguments(int argc, char **argv, BenchmarkConfig &config) {
+	config.min_threads = 8;
+	config.max_threads = 8;
+	config.thread_step = 0;
+	config.ops_per_thread = 500000;
+	config.duration = 0;
+	config.push_ratio = 0.5;
+	config.mixed = false;
+	config.batch_size = 1;
+	config.elimination_width = 0;
+	config.prefill = 0;
+	config.repetitions = 3;
+	config.latency_sample = 1;
+	config.pin_threads = false;
+	config.verify = false;
+	config.format = "text";
 
-	// Start the threads and start timing the execution time
-	auto t1 = std::chrono::steady_clock::now();
-	for(int i = 0; i < thread_count; i++) {
-		args[i].data = i;
-		args[i].execution_limit = execution_limit;		
-		if(i < split_count)
-			args[i].operation = 0;
-		else
-			args[i].operation = 1;
-		pthread_create(&thread[i],NULL,run,(void *)&args[i]);
-	}
-	
-	// Wait for the threads to complete
-	for(int i = 0; i < thread_count; i++) {
-		pthread_join(thread[i],NULL);
+	static struct option options[] = {
+		{"threads", required_argument, NULL, 't'},
+		{"thread-step", required_argument, NULL, 's'},
+		{"ops", required_argument, NULL, 'n'},
+		{"duration", required_argument, NULL, 'd'},
+		{"push-ratio", required_argument, NULL, 'p'},
+		{"mixed", no_argument, NULL, 'm'},
+		{"batch", required_argument, NULL, 'b'},
+		{"elimination", required_argument, NULL, 'e'},
+		{"prefill", required_argument, NULL, 'f'},
+		{"repeat", required_argument, NULL, 'r'},
+		{"latency-sample", required_argument, NULL, 'l'},
+		{"pin", no_argument, NULL, 'P'},
+		{"verify", no_argument, NULL, 'V'},
+		{"format", required_argument, NULL, 'o'},
+		{"help", no_argument, NULL, 'h'},
+		{NULL, 0, NULL, 0}
+	};
+	int c;
+	while((c = getopt_long(argc, argv, "t:s:n:d:p:mb:e:f:r:l:PVo:h", options, NULL)) != -1) {
+		std::istringstream ss(optarg != NULL ? optarg : "");
+		char dash;
+		bool ok = true;
+		switch(c) {
+		case 't':
+			ok = (bool)(ss >> config.min_threads);
+			config.max_threads = config.min_threads;
+			if(ok && ss >> dash)
+				ok = dash == '-' && (ss >> config.max_threads);
+			break;
+		case 's': ok = (bool)(ss >> config.thread_step); break;
+		case 'n': ok = (bool)(ss >> config.ops_per_thread); break;
+		case 'd': ok = (bool)(ss >> config.duration); break;
+		case 'p': ok = (bool)(ss >> config.push_ratio) && config.push_ratio >= 0 && config.push_ratio <= 1; break;
+		case 'm': config.mixed = true; break;
+		case 'b': ok = (bool)(ss >> config.batch_size) && config.batch_size > 0; break;
+		case 'e': ok = (bool)(ss >> config.elimination_width); break;
+		case 'f': ok = (bool)(ss >> config.prefill); break;
+		case 'r': ok = (bool)(ss >> config.repetitions) && config.repetitions > 0; break;
+		case 'l': ok = (bool)(ss >> config.latency_sample); break;
+		case 'P': config.pin_threads = true; break;
+		case 'V': config.verify = true; break;
+		case 'o':
+			config.format = optarg;
+			ok = config.format == "text" || config.format == "csv" || config.format == "json";
+			break;
+		default: return false;
+		}
+		if(!ok) {
+			std::cerr << "Invalid argument for -" << (char)c << ": " << optarg << std::endl;
+			return false;
+		}
 	}
-	auto t2 = std::chrono::steady_clock::now();
-   	auto elapsed = std::chrono::duration_cast< std::chrono::milliseconds>(t2 - t1);
-
-   	// Display some metrics
-   	std::cout << "no. of threads = " << thread_count << std::endl;
-   	std::cout << "split ratio = " << split_ratio << std::endl;
-   	std::cout << "execution count per thread = " << execution_limit << std::endl;
-   	std::cout << "time elapsed = " << elapsed.count() << " milliseconds!" << std::endl;
+	return config.min_threads > 0 && config.max_threads >= config.min_threads;
 }
 
-
 // Main function
-int main() {
-	
-	// Test cases
-	for(int i = 8; i <= 8; i++) {
-		std::cout << i << std::endl;
-		run_test(i, 500000, 1);
-		run_test(i, 500000, 0.5);
-		run_test(i, 500000, 0.75);
+int main(int argc, char **argv) {
+
+	BenchmarkConfig config;
+	if(!parse_arguments(argc, argv, config)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if(config.format == "csv")
+		print_csv_header();
+	bool first = true;
+	bool failed = false;
+	for(int threads = config.min_threads; threads <= config.max_threads;
+			threads = config.thread_step > 0 ? threads + config.thread_step : threads * 2) {
+		std::vector<RunResult> runs;
+		for(int i = 0; i < config.repetitions; i++) {
+			runs.push_back(run_test(config, threads));
+			failed = failed || runs.back().verify_errors > 0;
+		}
+		Summary s = summarize(threads, runs);
+		if(config.format == "text")
+			print_text(config, s);
+		else if(config.format == "csv")
+			print_csv(config, s);
+		else
+			print_json(config, s, first);
+		first = false;
 	}
+	if(config.format == "json")
+		std::cout << (first ? "[]" : "\n]") << std::endl;
+	return failed ? 2 : 0;
 }
@@ -0,0 +1,1395 @@
+
+/*
+ * Lock-free concurrent vector (dynamically resizable array) implementation in C++.
+ * Original paper: http://www.stroustrup.com/lock-free-vector.pdf
+ */
+
+#ifndef LOCK_FREE_VECTOR_HPP
+#define LOCK_FREE_VECTOR_HPP
+
+#include <iostream>
+#include <atomic>
+#include <optional>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <type_traits>
+#include <climits>
+#include <utility>
+#include <mutex>
+#include <cstdlib>
+#include <new>
+#include <pthread.h>
+#include "epoch_manager.hpp"
+#include "memory_orders.hpp"
+#include "elimination_array.hpp"
+#include "object_pool.hpp"
+#include "contention_counters.hpp"
+#include "bucket_file.hpp"
+#include "bucket_allocator.hpp"
+#include "bucket_kernels.hpp"
+
+// Set when compiled with -fsanitize=thread, by GCC or clang
+#if defined(__SANITIZE_THREAD__)
+#define VECTOR_TSAN 1
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define VECTOR_TSAN 1
+#endif
+#endif
+
+// Trait to check if std::atomic<T> can hold the type without falling back to a lock
+template<typename T, bool = std::is_trivially_copyable<T>::value>
+struct is_lock_free_atomic : std::false_type {};
+
+template<typename T>
+struct is_lock_free_atomic<T, true> : std::integral_constant<bool, std::atomic<T>::is_always_lock_free> {};
+
+// Storage scheme used by the vector's buckets for a given element type
+/* Types that fit in a lock-free atomic are stored directly in the buckets. Anything larger, or anything that is not trivially copyable,
+ * is constructed once on the heap and the buckets hold atomic pointers to it. A node stays in its slot after being popped until the
+ * next push to that position replaces it, and is then released along with the write operation that replaced it. Readers may still be
+ * copying or comparing it in the meantime, so a pop copies the element out of it rather than moving it. Only a node that was never
+ * published, such as one handed over by the elimination array, is moved from.
+ * A pending write is completed by swapping the value its slot held when the write was prepared for the new one, which is open to
+ * ABA. A helper that finds the write pending and then stalls can still complete it much later, over a newer element, if the slot
+ * holds a value equal to the old one again by then. Inline elements are compared by value, so a later push of the element that the
+ * write replaced is enough. Heap nodes are not reused while the helper stays in its epoch, so with heap storage it takes a bucket
+ * that was released and allocated again, whose slots are NULL once more. Tagging every slot with a version would close this, at the
+ * cost of the plain layout that the scan kernels and the data file rely on.
+ */
+template<typename T, bool Inline = is_lock_free_atomic<T>::value>
+struct ElementStorage {
+	typedef std::atomic<T> slot_type;
+	typedef T stored_type;
+	// Ordering of the loads that bulk scans make of a slot. An element stored inline carries no other data to make visible.
+	static const std::memory_order read_order = VECTOR_ORDER(relaxed);
+
+	template<typename... Args>
+	static stored_type make(Args&&... args) {return T(std::forward<Args>(args)...);}
+	static T take(stored_type value) {return value;}
+	static T take_unpublished(stored_type value) {return value;}
+	static const T &peek(const stored_type &value) {return value;}
+	static void release(stored_type) {}
+
+	// Functions to update a published slot in place
+	static void store(slot_type *slot, const T &data) {slot->store(data, VECTOR_ORDER(release));}
+	static bool compare_exchange(slot_type *slot, T &expected, const T &desired) {
+		return slot->compare_exchange_strong(expected, desired, VECTOR_ORDER(acq_rel), VECTOR_ORDER(acquire));
+	}
+};
+
+template<typename T>
+struct ElementStorage<T, false> {
+	typedef std::atomic<T *> slot_type;
+	typedef T *stored_type;
+	// A node has to be acquired along with its pointer, as its contents were written before the pointer was published
+	static const std::memory_order read_order = VECTOR_ORDER(acquire);
+
+	template<typename... Args>
+	static stored_type make(Args&&... args) {return new T(std::forward<Args>(args)...);}
+	static T take(stored_type value) {return *value;}
+	static T take_unpublished(stored_type value) {return std::move(*value);}
+	static const T &peek(const stored_type &value) {return *value;}
+	static void release(stored_type value) {delete value;}
+
+	// Functions to update a published slot in place
+	/* The element is replaced by a new node and the old one is retired, since readers in an earlier epoch may still be copying it.
+	 * Such a node is not owned by any write operation, as write operations only own the values they replaced.
+	 */
+	static void store(slot_type *slot, const T &data) {
+		T *old_node = slot->exchange(new T(data), VECTOR_ORDER(acq_rel));
+		EpochManager::instance().retire(old_node, destroy);
+	}
+
+	static bool compare_exchange(slot_type *slot, T &expected, const T &desired) {
+		T *new_node = NULL;
+		T *old_node = slot->load(VECTOR_ORDER(acquire));
+		while(true) {
+			if(!(*old_node == expected)) {
+				delete new_node;
+				expected = *old_node;
+				return false;
+			}
+			if(new_node == NULL)
+				new_node = new T(desired);
+			// The node might have been replaced by a concurrent update, in which case its value is compared again
+			if(slot->compare_exchange_strong(old_node, new_node, VECTOR_ORDER(acq_rel), VECTOR_ORDER(acquire))) {
+				EpochManager::instance().retire(old_node, destroy);
+				return true;
+			}
+		}
+	}
+
+	// Function used by the epoch manager to free a replaced node
+	static void destroy(void *ptr) {delete (T *)ptr;}
+};
+
+// Object to specify the write operation details for the helping thread
+/* A write operation covers count consecutive positions starting at position. The values of a batch are kept in the old_values and
+ * new_values arrays, which come from a thread-local ArrayPool as well, while a single element write points them at its own
+ * old_value and new_value fields.
+ * Write operations and descriptors are allocated from thread-local pools and each one is aligned to its own cache line, so that
+ * objects published by different threads never share one.
+ */
+template<typename T>
+class alignas(64) WriteDesc {
+public:
+	typedef typename ElementStorage<T>::stored_type stored_type;
+	// Cleared with release once the new values are in their slots, so a thread that loads it as false with acquire reads them
+	std::atomic<bool> pending;
+	stored_type old_value;
+	long long position;
+	stored_type new_value;
+	long long count;
+	stored_type *old_values;
+	stored_type *new_values;
+	WriteDesc(stored_type nv, stored_type ov, long long pos) : old_value(ov), new_value(nv) {
+		position = pos;
+		pending.store(true, VECTOR_ORDER(relaxed));
+		count = 1;
+		old_values = &old_value;
+		new_values = &new_value;
+	}
+	WriteDesc(long long n, long long pos) : old_value(), new_value() {
+		position = pos;
+		pending.store(true, VECTOR_ORDER(relaxed));
+		count = n;
+		old_values = ArrayPool<stored_type>::allocate(n);
+		new_values = ArrayPool<stored_type>::allocate(n);
+	}
+	// A write operation is only freed once it has completed, so the old values it replaced are no longer in the vector
+	~WriteDesc() {
+		for(long long i = 0; i < count; i++)
+			ElementStorage<T>::release(old_values[i]);
+		if(old_values != &old_value) {
+			ArrayPool<stored_type>::deallocate(old_values, count);
+			ArrayPool<stored_type>::deallocate(new_values, count);
+		}
+	}
+};
+
+// Object to specify the buckets released by a shrink
+/* The buckets are taken out of the bucket table by whichever thread completes the shrink, but they are only freed along with the
+ * descriptor that carries the shrink. No thread can still be reading the old buckets by then, and since their memory cannot be
+ * reused before that, a late helper can never take a newly allocated bucket at the same address out of the table by mistake.
+ * Elements stored on the heap that were popped from a released bucket are still owned by their slots, and are freed with it.
+ */
+template<typename T>
+class ShrinkDesc {
+public:
+	typedef typename ElementStorage<T>::slot_type location;
+	std::atomic<bool> pending;
+	// Released buckets are [first, first + count), with the memory, no. of slots and mapping length of each
+	int first;
+	int count;
+	location *arrays[64];
+	long long slots[64];
+	size_t lengths[64];
+	ShrinkDesc(int f) : pending(true), first(f), count(0) {}
+
+	// Function to free the buckets of a shrink that has been published and completed, along with the shrink itself
+	static void release(ShrinkDesc *op) {
+		for(int i = 0; i < op->count; i++) {
+			if(op->arrays[i] == NULL)
+				continue;
+			if(!is_lock_free_atomic<T>::value) {
+				for(long long j = 0; j < op->slots[i]; j++)
+					ElementStorage<T>::release(op->arrays[i][j].load(VECTOR_ORDER(acquire)));
+			}
+			BucketAllocator::release(op->arrays[i], op->lengths[i]);
+		}
+		delete op;
+	}
+};
+
+#ifdef VECTOR_WAIT_FREE
+template<typename T>
+class Descriptor;
+
+// Object to specify an operation announced by a thread that failed to swap the descriptor too many times
+/* The announcement is referenced by its thread, which retires it once the operation is complete, and by the descriptor that applied
+ * the operation, which lagging threads may still be completing. It is freed once both references are gone.
+ */
+template<typename T>
+class alignas(64) Announcement {
+public:
+	typedef typename ElementStorage<T>::stored_type stored_type;
+	enum Type {PUSH, POP};
+	Type type;
+	// Element to push
+	stored_type value;
+	// Descriptor that applied the operation, set exactly once
+	std::atomic<Descriptor<T> *> completed;
+	std::atomic<int> references;
+	Announcement(Type t, stored_type v) : type(t), value(v), completed(NULL), references(2) {}
+
+	// Function to drop one of the references to an announcement
+	static void release(void *ptr) {
+		Announcement *a = (Announcement *)ptr;
+		if(a->references.fetch_sub(1) == 1)
+			ObjectPool<Announcement>::deallocate(a);
+	}
+};
+#endif
+
+// Object to specify the pending write operation
+template<typename T>
+class alignas(64) Descriptor {
+public:
+	// Like every other field, the size is only written before the descriptor is published and the swap that publishes it makes it
+	// visible, so it does not need to be atomic
+	long long size;
+	WriteDesc<T> *write_op;
+	// No. of swaps that removed elements since the vector was created. Pushes only ever write at or past the size of the descriptor
+	// they replace, so as long as this count does not change, no element below a size read earlier has been touched by a push or pop.
+	unsigned long pops;
+	// Buckets released by this descriptor, NULL unless it was installed by a shrink
+	ShrinkDesc<T> *shrink_op;
+#ifdef VECTOR_WAIT_FREE
+	// Announced operation this descriptor applies on behalf of another thread, NULL on the fast path
+	Announcement<T> *owner;
+	// Element removed by an announced pop, if the vector was not empty
+	bool has_popped;
+	typename ElementStorage<T>::stored_type popped;
+	Descriptor(long long s, WriteDesc<T> *w) : pops(0), shrink_op(NULL), owner(NULL), has_popped(false), popped() {size = s,write_op = w;}
+#else
+	Descriptor(long long s, WriteDesc<T> *w) : pops(0), shrink_op(NULL) {size = s,write_op = w;}
+#endif
+
+	// Function used by the epoch manager to free a retired descriptor along with its write operation
+	// Both are returned to the pools of the thread that collects them.
+	static void destroy(void *ptr) {
+		Descriptor *d = (Descriptor *)ptr;
+#ifdef VECTOR_WAIT_FREE
+		if(d->owner != NULL)
+			Announcement<T>::release(d->owner);
+#endif
+		if(d->shrink_op != NULL)
+			ShrinkDesc<T>::release(d->shrink_op);
+		ObjectPool<WriteDesc<T> >::deallocate(d->write_op);
+		ObjectPool<Descriptor>::deallocate(d);
+	}
+};
+
+// Lock-free vector class implementation
+template<typename T>
+class Vector {
+
+	typedef ElementStorage<T> storage;
+	typedef typename storage::stored_type stored_type;
+	// 2-level array of atomic variables
+	/* Bucket k holds first_bucket_size << k slots, so 62 buckets cover every index a long long can hold. Buckets are only allocated
+	 * when a push first reaches them, and the memory of a large bucket is only committed by the OS as its pages are first written.
+	 */
+	typedef typename storage::slot_type location;
+	static const int BUCKETS = 62;
+	std::atomic<location *> memory[BUCKETS];
+	// Pointer to a descriptor object
+	/* Memory orderings: a descriptor, its write operation and its shrink are filled in before the swap that publishes them and never
+	 * change afterwards, apart from the pending flags. So loading the descriptor with acquire is enough to read all of them. The
+	 * swaps themselves stay seq_cst, although release would publish the descriptor: together with the fence in
+	 * EpochManager::enter(), they ensure that a thread still holding a swapped out descriptor is seen by the epoch manager, which
+	 * would otherwise be free to reclaim it. A failed swap reads nothing, as every loop loads the descriptor again.
+	 * The pending flags are cleared with release once the slots or the bucket table have been updated, and loaded with acquire, so a
+	 * thread that finds an operation done sees its effects. Buckets are published with release and loaded with acquire. Elements are
+	 * written with release, since a heap element is published through its pointer, and scans read them with the weakest order that
+	 * still makes the element itself visible (ElementStorage::read_order).
+	 */
+	std::atomic<Descriptor<T> *> descriptor;
+	// Variable to specify the initial size of the array
+	int first_bucket_size;
+	// Highest set bit of first_bucket_size, which is a power of 2
+	int first_bucket_bit;
+	// Optional elimination array in front of the descriptor, NULL if elimination is disabled
+	EliminationArray<stored_type> *elimination;
+	// Per-thread contention counters, empty unless compiled with -DVECTOR_STATS
+	ContentionCounters counters;
+	// Allocator of the buckets of a heap vector, which applies its page size and NUMA placement policy
+	BucketAllocator allocator;
+	// Data file the buckets are mapped from, NULL if the vector lives on the heap
+	BucketFile *file;
+	// Keeps checkpoints of a file-backed vector from overlapping
+	std::mutex sync_lock;
+
+	// Function to hand the element of a push that lost the descriptor CAS directly to a concurrent pop
+	bool try_eliminate_push(WriteDesc<T> *write_op, Descriptor<T> *new_descriptor) {
+		if(elimination == NULL || !elimination->try_push(write_op->new_value))
+			return false;
+		// The element now belongs to the pop, and the unpublished write operation never replaced the old value it recorded
+		write_op->old_value = stored_type();
+		ObjectPool<WriteDesc<T> >::deallocate(write_op);
+		ObjectPool<Descriptor<T> >::deallocate(new_descriptor);
+		return true;
+	}
+
+	// Function to take the element of a concurrent push that lost the descriptor CAS
+	bool try_eliminate_pop(stored_type &data) {
+		return elimination != NULL && elimination->try_pop(data);
+	}
+
+	// Function to get the element exchanged through the elimination array
+	// A heap node handed over by a push was never published in the vector, so the pop owns it outright.
+	T take_eliminated(stored_type data) {
+		T value = storage::take_unpublished(data);
+		storage::release(data);
+		return value;
+	}
+
+#ifdef VECTOR_WAIT_FREE
+	// No. of descriptor swaps a push or pop attempts on the fast path before announcing itself
+	static const int FAST_PATH_ATTEMPTS = 16;
+
+	// Announcement array slot of a thread, padded to its own cache line
+	struct alignas(64) AnnouncementSlot {
+		std::atomic<Announcement<T> *> op;
+	};
+	// Announced operations, indexed by the epoch manager's thread index
+	AnnouncementSlot *announcements;
+
+	// Function to help the operation announced in the next slot, if any, before starting an operation of our own
+	/* Every thread checks the slots in a round robin, one per operation, and an announced operation that it finds is helped until it
+	 * completes. So once an operation is announced, every other thread starts helping it within a bounded no. of its own operations,
+	 * after which none of them can complete a swap that does not apply it. This bounds the no. of steps of every push and pop.
+	 * push_back_n(), pop_back_n() and shrink() help as well, so a stream of them cannot starve an announced operation either. They
+	 * never announce themselves though, so they are only lock-free.
+	 */
+	void help_announced() {
+		static thread_local int next = 0;
+		if(next >= EpochManager::instance().thread_count())
+			next = 0;
+		Announcement<T> *op = announcements[next++].op.load(VECTOR_ORDER(acquire));
+		while(op != NULL && op->completed.load(VECTOR_ORDER(acquire)) == NULL)
+			help(op);
+	}
+
+	// Function to make one attempt at applying an announced operation
+	void help(Announcement<T> *op) {
+		Descriptor<T> *local_descriptor = descriptor.load(VECTOR_ORDER(acquire));
+		complete(local_descriptor, true);
+		// The operation is only checked once the current descriptor has been completed. If a descriptor applying it was installed
+		// before the current one was loaded, it has been completed by now, and if one is installed after, the swap below fails. So
+		// the operation cannot be applied twice.
+		if(op->completed.load(VECTOR_ORDER(acquire)) != NULL)
+			return;
+		long long size = local_descriptor->size;
+		Descriptor<T> *new_descriptor;
+		if(op->type == Announcement<T>::PUSH) {
+			WriteDesc<T> *write_op = ObjectPool<WriteDesc<T> >::allocate(op->value, reserve(size)->load(storage::read_order), size);
+			new_descriptor = ObjectPool<Descriptor<T> >::allocate(size + 1, write_op);
+			new_descriptor->pops = local_descriptor->pops;
+		}
+		else {
+			// Popping from an empty vector still swaps in a descriptor of the same size, which linearizes the empty result
+			new_descriptor = ObjectPool<Descriptor<T> >::allocate(size > 0 ? size - 1 : 0, (WriteDesc<T> *)NULL);
+			new_descriptor->pops = local_descriptor->pops + 1;
+			if(size > 0) {
+				new_descriptor->has_popped = true;
+				location *slot = find(size - 1);
+				new_descriptor->popped = slot != NULL ? slot->load(storage::read_order) : stored_type();
+			}
+		}
+		new_descriptor->owner = op;
+		if(descriptor.compare_exchange_strong(local_descriptor, new_descriptor, VECTOR_ORDER(seq_cst), VECTOR_ORDER(relaxed))) {
+			EpochManager::instance().retire(local_descriptor, Descriptor<T>::destroy);
+			complete(new_descriptor, false);
+			return;
+		}
+		counters.add(op->type == Announcement<T>::PUSH ? ContentionCounters::PUSH_CAS_FAILURES : ContentionCounters::POP_CAS_FAILURES);
+		// The descriptor was never published, so neither its write operation nor its reference to the announcement count
+		if(new_descriptor->write_op != NULL) {
+			new_descriptor->write_op->old_value = stored_type();
+			ObjectPool<WriteDesc<T> >::deallocate(new_descriptor->write_op);
+		}
+		ObjectPool<Descriptor<T> >::deallocate(new_descriptor);
+	}
+
+	// Function to announce an operation and help it until it completes
+	// Returns the descriptor that applied it, which stays valid until the caller leaves its epoch.
+	Descriptor<T> *run_announced(Announcement<T> *op) {
+		AnnouncementSlot &slot = announcements[EpochManager::instance().thread_index()];
+		slot.op.store(op, VECTOR_ORDER(release));
+		while(op->completed.load(VECTOR_ORDER(acquire)) == NULL)
+			help(op);
+		slot.op.store(NULL, VECTOR_ORDER(relaxed));
+		Descriptor<T> *applied = op->completed.load(VECTOR_ORDER(acquire));
+		EpochManager::instance().retire(op, Announcement<T>::release);
+		return applied;
+	}
+
+	// Function to switch a push from the fast path to the announcement array
+	void announce_push(WriteDesc<T> *write_op, Descriptor<T> *new_descriptor) {
+		Announcement<T> *op = ObjectPool<Announcement<T> >::allocate(Announcement<T>::PUSH, write_op->new_value);
+		write_op->old_value = stored_type();
+		ObjectPool<WriteDesc<T> >::deallocate(write_op);
+		ObjectPool<Descriptor<T> >::deallocate(new_descriptor);
+		run_announced(op);
+	}
+
+	// Function to switch a pop from the fast path to the announcement array
+	std::optional<T> announce_pop(Descriptor<T> *new_descriptor) {
+		ObjectPool<Descriptor<T> >::deallocate(new_descriptor);
+		Descriptor<T> *applied = run_announced(ObjectPool<Announcement<T> >::allocate(Announcement<T>::POP, stored_type()));
+		if(!applied->has_popped)
+			return std::nullopt;
+		// As on the fast path, the buckets the pop left well above the size are given back
+		release_unused(applied->size);
+		return storage::take(applied->popped);
+	}
+#endif
+
+	// Function to complete a descriptor before it can be replaced
+	// Its pending write is completed and, in wait-free mode, the operation it applied on behalf of another thread is marked done.
+	// helping is true if the descriptor was installed by another thread, which is only used for the contention counters.
+	void complete(Descriptor<T> *d, bool helping) {
+		complete_write(d->write_op, helping);
+		complete_shrink(d->shrink_op);
+#ifdef VECTOR_WAIT_FREE
+		if(d->owner != NULL && d->owner->completed.load(VECTOR_ORDER(acquire)) == NULL) {
+			Descriptor<T> *expected = NULL;
+			d->owner->completed.compare_exchange_strong(expected, d, VECTOR_ORDER(release), VECTOR_ORDER(relaxed));
+		}
+#endif
+	}
+
+	// Function to get the slot for a given index using shifts only
+	/* Index i lives at position i + first_bucket_size of a conceptual array whose k-th bucket covers the positions that have their
+	 * highest set bit at first_bucket_bit + k. Clearing that bit gives the offset inside the bucket.
+	 */
+	location *locate(long long i) {
+		long long pos = i + first_bucket_size;
+		int hibit = highest_bit(pos);
+		return &memory[hibit - first_bucket_bit].load(VECTOR_ORDER(acquire))[pos ^ (1LL << hibit)];
+	}
+
+	// Function to get the bucket holding a given index
+	int bucket_of(long long i) {
+		return highest_bit(i + first_bucket_size) - first_bucket_bit;
+	}
+
+	// Function to get the slot for a given index, NULL if its bucket is not allocated
+	/* A thread working from a descriptor that has since been replaced can reach an index whose bucket was released by a shrink. Its
+	 * swap is bound to fail, but it must not touch the bucket table entry, so every index taken from a descriptor goes through here.
+	 */
+	location *find(long long i) {
+		long long pos = i + first_bucket_size;
+		int hibit = highest_bit(pos);
+		location *array = memory[hibit - first_bucket_bit].load(VECTOR_ORDER(acquire));
+		return array != NULL ? &array[pos ^ (1LL << hibit)] : NULL;
+	}
+
+	// Function to get the slot for a given index to push to, allocating its bucket if needed
+	location *reserve(long long i) {
+		location *slot;
+		while((slot = find(i)) == NULL)
+			alloc_bucket(bucket_of(i));
+		return slot;
+	}
+
+	// Function to get the no. of slots in a given bucket
+	long long bucket_size(int bucket) {
+		return (long long)first_bucket_size << bucket;
+	}
+
+	// Contiguous range of slots inside a single bucket, along with the index of its first slot
+	struct Piece {
+		location *slots;
+		long long first;
+		long long count;
+	};
+
+	// Functions to search, count and bound the elements of a piece
+	/* A vector of ints is handed to the vectorized kernels, which read the slots of the piece as a plain int array. Every other
+	 * element type is read slot by slot.
+	 * The plain reads race with write() and compare_exchange(), which change a slot in place without counting as a pop, so the
+	 * validation of the scan does not discard them. On the cpus the kernels are built for, each of those reads is an aligned load
+	 * that returns either the old or the new element, the same as a relaxed atomic load would, so a scan sees a concurrent write or
+	 * not, element by element, either way. It is still a data race as far as the language goes, which is why the kernels are left
+	 * out under -fsanitize=thread, and ints are read slot by slot like every other type there.
+	 */
+#ifdef VECTOR_TSAN
+	static const bool plain_scans = false;
+#else
+	static const bool plain_scans = std::is_same<T, int>::value;
+#endif
+
+	static const int *ints(const Piece &piece) {
+		static_assert(sizeof(location) == sizeof(int) && alignof(location) == alignof(int), "slots must be laid out as ints");
+		return reinterpret_cast<const int *>(piece.slots);
+	}
+
+	long long find_in(const Piece &piece, const T &value) {
+		if constexpr(plain_scans)
+			return BucketKernels::find(ints(piece), piece.count, value);
+		else {
+			for(long long i = 0; i < piece.count; i++) {
+				if(storage::peek(piece.slots[i].load(storage::read_order)) == value)
+					return i;
+			}
+			return -1;
+		}
+	}
+
+	long long count_in(const Piece &piece, const T &value) {
+		if constexpr(plain_scans)
+			return BucketKernels::count(ints(piece), piece.count, value);
+		else
+			return count_in_if(piece, [&](const T &element) {return element == value;});
+	}
+
+	template<typename Predicate>
+	long long count_in_if(const Piece &piece, const Predicate &pred) {
+		long long count = 0;
+		for(long long i = 0; i < piece.count; i++)
+			count += pred(storage::peek(piece.slots[i].load(storage::read_order))) ? 1 : 0;
+		return count;
+	}
+
+	// Function to get the minimum and maximum of a piece, which is never empty
+	std::pair<T, T> minmax_in(const Piece &piece) {
+		if constexpr(plain_scans) {
+			int low = INT_MAX, high = INT_MIN;
+			BucketKernels::minmax(ints(piece), piece.count, low, high);
+			return std::make_pair(low, high);
+		}
+		else {
+			T low = storage::peek(piece.slots[0].load(storage::read_order));
+			T high = low;
+			for(long long i = 1; i < piece.count; i++) {
+				stored_type loaded = piece.slots[i].load(storage::read_order);
+				const T &element = storage::peek(loaded);
+				if(element < low)
+					low = element;
+				if(high < element)
+					high = element;
+			}
+			return std::make_pair(low, high);
+		}
+	}
+
+	// Function to get the minimum and maximum of a linearizable view of the vector, empty if the vector is empty
+	std::optional<std::pair<T, T> > minmax(int threads) {
+		EpochGuard guard;
+		std::vector<Piece> parts;
+		std::vector<std::optional<std::pair<T, T> > > partials;
+		auto bound = [&](size_t p, const Piece &piece) {
+			partials[p] = minmax_in(piece);
+		};
+		auto prepare = [&](long long, size_t count) {
+			partials.clear();
+			partials.resize(count);
+		};
+		while(!scan(threads, parts, prepare, bound));
+		std::optional<std::pair<T, T> > result;
+		for(size_t p = 0; p < partials.size(); p++) {
+			if(!result)
+				result = partials[p];
+			else {
+				if(partials[p]->first < result->first)
+					result->first = partials[p]->first;
+				if(result->second < partials[p]->second)
+					result->second = partials[p]->second;
+			}
+		}
+		return result;
+	}
+
+	// Function to split the indices [0, size) into pieces for the given no. of threads
+	/* Pieces never cross a bucket boundary, so each one is a plain walk over a contiguous array. Since every bucket is twice the size
+	 * of the previous one, whole buckets would leave most of the work to whoever gets the last one, so large buckets are cut into
+	 * several pieces and the threads take them one at a time.
+	 */
+	std::vector<Piece> pieces(long long size, int threads) {
+		std::vector<Piece> result;
+		long long grain = std::max(size / ((long long)threads * 4), 4096LL);
+		for(int bucket = 0; bucket < BUCKETS; bucket++) {
+			long long start = bucket_size(bucket) - first_bucket_size;
+			if(start >= size)
+				break;
+			long long end = std::min(start + bucket_size(bucket), size);
+			location *array = memory[bucket].load(VECTOR_ORDER(acquire));
+			for(long long first = start; first < end; first += grain) {
+				Piece piece = {array != NULL ? array + (first - start) : NULL, first, std::min(grain, end - first)};
+				result.push_back(piece);
+			}
+		}
+		return result;
+	}
+
+	template<typename F>
+	static void *parallel_worker(void *ptr) {
+		(*(F *)ptr)();
+		return NULL;
+	}
+
+	// Function to run a worker function on the given no. of threads, the calling thread being one of them
+	// The workers share their pieces through a counter, so if a thread cannot be created the others simply take on its share.
+	template<typename F>
+	static void run_parallel(int threads, F &worker) {
+		std::vector<pthread_t> thread(std::max(threads - 1, 0));
+		std::vector<bool> started(thread.size(), false);
+		for(size_t i = 0; i < thread.size(); i++)
+			started[i] = pthread_create(&thread[i], NULL, parallel_worker<F>, &worker) == 0;
+		worker();
+		for(size_t i = 0; i < thread.size(); i++) {
+			if(started[i])
+				pthread_join(thread[i], NULL);
+		}
+	}
+
+	// Function to visit every element of a consistent view of the vector, split across threads
+	/* prepare(size, parts) is called once the current descriptor has been loaded and its pending write completed, then
+	 * visit(piece_index, piece) is called once for every piece of [0, size). The scan is only valid if no swap removed an element
+	 * before it was over. Otherwise the positions below size could have been popped and pushed again, so scan() returns false and
+	 * the caller starts over. Appending writers never invalidate a scan. The caller has to stay in its epoch for the whole scan,
+	 * which keeps the elements being read from being freed.
+	 */
+	template<typename Prepare, typename Visit>
+	bool scan(int threads, std::vector<Piece> &parts, Prepare prepare, Visit &visit) {
+		Descriptor<T> *local_descriptor = current_descriptor();
+		unsigned long pops = local_descriptor->pops;
+		parts = pieces(local_descriptor->size, threads);
+		// A pop and a shrink may already have released some of the buckets, in which case the scan is invalid anyway
+		for(size_t p = 0; p < parts.size(); p++) {
+			if(parts[p].slots == NULL)
+				return false;
+		}
+		prepare(local_descriptor->size, parts.size());
+		std::atomic<size_t> next(0);
+		auto worker = [&]() {
+			for(size_t p = next++; p < parts.size(); p = next++)
+				visit(p, parts[p]);
+		};
+		run_parallel(std::min(threads, (int)parts.size()), worker);
+		// The fence keeps the relaxed element loads from moving past the check. If one of them read an element pushed after a pop,
+		// the descriptor of that pop is seen here.
+		std::atomic_thread_fence(VECTOR_ORDER(acquire));
+		return descriptor.load(VECTOR_ORDER(acquire))->pops == pops;
+	}
+
+	// Function to set up a vector of the given size, whose buckets up to that size are allocated
+	void init(int elimination_width, long long size) {
+		elimination = elimination_width > 0 ? new EliminationArray<stored_type>(elimination_width) : NULL;
+		Descriptor<T> *temp = ObjectPool<Descriptor<T> >::allocate(size, (WriteDesc<T> *)NULL);
+		descriptor = temp;
+		first_bucket_size = 2;
+		first_bucket_bit = highest_bit(first_bucket_size);
+		for(int i = 0; i < BUCKETS; i++)
+			memory[i] = NULL;
+		for(int i = 0; i == 0 || (i < BUCKETS && bucket_size(i) - first_bucket_size < size); i++)
+			memory[i] = new_bucket(i);
+#ifdef VECTOR_WAIT_FREE
+		announcements = new AnnouncementSlot[EpochManager::MAX_THREADS];
+		for(int i = 0; i < EpochManager::MAX_THREADS; i++)
+			announcements[i].op = NULL;
+#endif
+	}
+
+	// Function to get the descriptor to validate an index against, after helping its pending write complete so that every index
+	// below its size holds a published element
+	Descriptor<T> *current_descriptor() {
+		Descriptor<T> *local_descriptor = descriptor.load(VECTOR_ORDER(acquire));
+		complete(local_descriptor, true);
+		return local_descriptor;
+	}
+
+public:
+	// Public constructor
+	// Passing a non-zero elimination_width puts an elimination array with that many slots in front of the descriptor, so that
+	// pushes and pops that collide under contention can exchange their elements without touching the vector. The policy decides
+	// the page size, NUMA placement and pre-faulting of the large buckets.
+	Vector(int elimination_width = 0, const BucketPolicy &policy = BucketPolicy()) : allocator(policy) {
+		file = NULL;
+		init(elimination_width, 0);
+	}
+
+	// Public constructor for a vector whose buckets are mapped from the data file at path
+	/* The file is created if it does not exist. Otherwise the vector is reopened with the size of the last checkpoint, and the buckets
+	 * holding its elements are mapped straight from the file, so nothing is copied or rebuilt. Only element types that are stored
+	 * inline can be kept in a file. Throws std::runtime_error if the file cannot be used.
+	 */
+	Vector(const std::string &path, int elimination_width = 0) {
+		static_assert(is_lock_free_atomic<T>::value, "only types stored inline in the buckets can be kept in a file");
+		file = new BucketFile(path, sizeof(location), 2);
+		init(elimination_width, file->committed_size());
+	}
+
+	// Destructor. Must not run concurrently with any other operation on the vector.
+	// A file-backed vector is checkpointed before its file is closed.
+	~Vector() {
+		if(file != NULL)
+			sync();
+		delete elimination;
+#ifdef VECTOR_WAIT_FREE
+		delete[] announcements;
+#endif
+		Descriptor<T>::destroy(descriptor.load());
+		for(int i = 0; i < BUCKETS; i++) {
+			location *array = memory[i];
+			if(array == NULL)
+				continue;
+			// Popped elements are still sitting in their slots, so every slot of an allocated bucket is released. Elements stored
+			// inline have nothing to release, which saves touching the untouched pages of a large bucket.
+			if(!is_lock_free_atomic<T>::value) {
+				for(long long j = 0; j < bucket_size(i); j++)
+					storage::release(array[j].load());
+			}
+			free_bucket(i, array);
+		}
+		delete file;
+	}
+
+	// Function to write a checkpoint of a file-backed vector
+	/* The buckets holding the elements of the current size are flushed to the file and then the size is committed to the header.
+	 * After a crash the vector reopens with the size of the last completed checkpoint. Elements popped and pushed again since then
+	 * may come back with their newer values, since their pages can reach the file at any time. Does nothing for a heap vector.
+	 */
+	void sync() {
+		if(file == NULL)
+			return;
+		std::lock_guard<std::mutex> lock(sync_lock);
+		EpochGuard guard;
+		long long size = current_descriptor()->size;
+		for(int bucket = 0; bucket < BUCKETS; bucket++) {
+			long long start = bucket_size(bucket) - first_bucket_size;
+			if(start >= size)
+				break;
+			location *array = memory[bucket].load(VECTOR_ORDER(acquire));
+			if(array != NULL)
+				file->flush(array, std::min(bucket_size(bucket), size - start));
+		}
+		file->commit(size);
+	}
+
+	// Function to return the current size of arraylist
+	long long size() {
+		EpochGuard guard;
+		Descriptor<T> *current_descriptor = descriptor.load(VECTOR_ORDER(acquire));
+		if(current_descriptor->write_op != NULL && current_descriptor->write_op->pending.load(VECTOR_ORDER(acquire)))
+			return current_descriptor->size - current_descriptor->write_op->count;
+		return current_descriptor->size;
+	}
+
+	// Function to get the position at a given index in the arraylist
+	// No bounds or size check is done, so the index must lie within an allocated bucket. Use read()/write() for checked access.
+	location* at(long long i) {
+		return locate(i);
+	}
+
+	// Function to read the element at a given index
+	/* The pending write of the current descriptor is completed before the index is checked against its size, so the element read is
+	 * one that was pushed before the linearization point. An empty optional is returned if the index is out of range.
+	 */
+	std::optional<T> read(long long i) {
+		EpochGuard guard;
+		Descriptor<T> *local_descriptor = current_descriptor();
+		if(i < 0 || i >= local_descriptor->size)
+			return std::nullopt;
+		// The index is out of range after all if a pop and a shrink released its bucket since the check
+		location *slot = find(i);
+		if(slot == NULL)
+			return std::nullopt;
+		return T(storage::peek(slot->load(VECTOR_ORDER(acquire))));
+	}
+
+	// Function to write an element at a given index
+	/* Returns false if the index is out of range. Like the paper's write(), updating an index concurrently with a pop that removes
+	 * it is not supported, since a push to the freed position would then race with this write.
+	 */
+	bool write(long long i, const T &data) {
+		EpochGuard guard;
+		Descriptor<T> *local_descriptor = current_descriptor();
+		if(i < 0 || i >= local_descriptor->size)
+			return false;
+		location *slot = find(i);
+		if(slot == NULL)
+			return false;
+		storage::store(slot, data);
+		return true;
+	}
+
+	// Function to atomically replace the element at a given index if it equals the expected value
+	// Behaves like std::atomic's compare_exchange_strong(): on failure, expected is updated with the element that was found. Returns
+	// false without touching expected if the index is out of range.
+	bool compare_exchange(long long i, T &expected, const T &desired) {
+		EpochGuard guard;
+		Descriptor<T> *local_descriptor = current_descriptor();
+		if(i < 0 || i >= local_descriptor->size)
+			return false;
+		location *slot = find(i);
+		if(slot == NULL)
+			return false;
+		return storage::compare_exchange(slot, expected, desired);
+	}
+
+	// Function to get the highest set bit in a given integer
+	int highest_bit(long long num) {
+		if(!num) return 0;
+		return 63 - __builtin_clzll(num);
+	}
+
+
+	// Function to push a copy of an element to the back of the vector
+	void push_back(const T &data) {
+		emplace_back(data);
+	}
+
+	// Function to move an element to the back of the vector
+	void push_back(T &&data) {
+		emplace_back(std::move(data));
+	}
+
+	// Function to construct an element at the back of the vector
+	/* The element is constructed exactly once, before the retry loop. For elements stored behind a pointer, only the pointer is
+	 * passed through the write operation, so the value itself is never copied.
+	 */
+	template<typename... Args>
+	void emplace_back(Args&&... args) {
+		// The descriptor loaded below and the write operation it points to may be retired by another thread at any time. Staying
+		// inside an epoch keeps them from being freed until this operation is over.
+		EpochGuard guard;
+		Descriptor<T> *local_descriptor;
+		// The new descriptor is private to this thread until the CAS below succeeds, so it is allocated once and refilled on every retry.
+		// Both objects come from the thread's pool, which the descriptors retired by earlier operations are recycled into.
+		WriteDesc<T> *write_op = ObjectPool<WriteDesc<T> >::allocate(storage::make(std::forward<Args>(args)...), stored_type(), 0);
+		Descriptor<T> *new_descriptor = ObjectPool<Descriptor<T> >::allocate(0, write_op);
+		bool eliminated = false;
+		int attempts = 0;
+#ifdef VECTOR_WAIT_FREE
+		help_announced();
+#endif
+		do {
+#ifdef VECTOR_WAIT_FREE
+			// After too many failed swaps, announce the push and let the other threads help it complete
+			if(attempts == FAST_PATH_ATTEMPTS) {
+				counters.add(ContentionCounters::PUSH_CAS_FAILURES, attempts);
+				counters.operation(attempts);
+				announce_push(write_op, new_descriptor);
+				return;
+			}
+#endif
+			attempts++;
+			local_descriptor = descriptor.load(VECTOR_ORDER(acquire));
+			// Take a local copy of the vector's descriptor and attempt to finish any pending writes before continuing with current
+			// write operation.
+			complete(local_descriptor, true);
+			// If the current bucket is full, a new bucket twice the current size is allocated
+			location *slot = reserve(local_descriptor->size);
+			// Fill in the write operation object that describes the details of the write operation to be performed and the new
+			// descriptor object which holds a reference to the write operation object and the new size of the vector.
+			// The value currently in the slot is recorded as well, and the write only replaces that value. This keeps helpers from
+			// writing it twice, but not a stalled helper from writing it over a later push of an equal value (see ElementStorage).
+			write_op->position = local_descriptor->size;
+			write_op->old_value = slot->load(storage::read_order);
+			write_op->pending.store(true, VECTOR_ORDER(relaxed));
+			new_descriptor->size = local_descriptor->size + 1;
+			new_descriptor->pops = local_descriptor->pops;
+			// The following compare_exchange_weak() is the linearization point for the push_back() operation, with respect to the other
+			// push and pop operations.
+			// If the thread fails to atomically swap the vector object's descriptor with it's descriptor object, then another thread has
+			// changed the state of the vector since the current thread obtained a local copy of the vector' descriptor and thus, has
+			// to redo the entire process again.
+			// If elimination is enabled, a failed swap is taken as a sign of contention and the element is offered to a concurrent pop
+			// instead of retrying right away.
+		} while(!descriptor.compare_exchange_weak(local_descriptor, new_descriptor, VECTOR_ORDER(seq_cst), VECTOR_ORDER(relaxed)) && !(eliminated = try_eliminate_push(write_op, new_descriptor)));
+		// An eliminated push failed its last swap as well
+		counters.add(ContentionCounters::PUSH_CAS_FAILURES, eliminated ? attempts : attempts - 1);
+		counters.operation(attempts - 1);
+		if(eliminated)
+			return;
+		// The old descriptor is no longer reachable from the vector, but other threads might still be reading it
+		EpochManager::instance().retire(local_descriptor, Descriptor<T>::destroy);
+		complete(new_descriptor, false);
+	}
+
+	// Function to push a range of elements to the back of the vector
+	/* All the elements are published with a single descriptor swap, whose write operation covers the whole range. The elements
+	 * are constructed once before the retry loop and the write is completed by this thread or by any helper that finds it pending,
+	 * so a batch that is only partially written when its thread stalls still gets finished. Ranges are counted in 64 bits, like the
+	 * indices, and one too large to be held in memory throws std::bad_alloc before anything is pushed.
+	 */
+	template<typename InputIt>
+	void push_back_n(InputIt first, InputIt last) {
+		long long count = std::distance(first, last);
+		if(count <= 0)
+			return;
+		EpochGuard guard;
+		Descriptor<T> *local_descriptor;
+		WriteDesc<T> *write_op = ObjectPool<WriteDesc<T> >::allocate(count, 0);
+		for(long long i = 0; i < count; i++, ++first)
+			write_op->new_values[i] = storage::make(*first);
+		Descriptor<T> *new_descriptor = ObjectPool<Descriptor<T> >::allocate(0, write_op);
+		int attempts = 0;
+#ifdef VECTOR_WAIT_FREE
+		help_announced();
+#endif
+		do {
+			attempts++;
+			local_descriptor = descriptor.load(VECTOR_ORDER(acquire));
+			complete(local_descriptor, true);
+			long long size = local_descriptor->size;
+			// Every bucket the range falls in is allocated along the way
+			write_op->position = size;
+			for(long long i = 0; i < count; i++)
+				write_op->old_values[i] = reserve(size + i)->load(storage::read_order);
+			write_op->pending.store(true, VECTOR_ORDER(relaxed));
+			new_descriptor->size = size + count;
+			new_descriptor->pops = local_descriptor->pops;
+			// Linearization point for the whole batch
+		} while(!descriptor.compare_exchange_weak(local_descriptor, new_descriptor, VECTOR_ORDER(seq_cst), VECTOR_ORDER(relaxed)));
+		counters.add(ContentionCounters::PUSH_CAS_FAILURES, attempts - 1);
+		counters.operation(attempts - 1);
+		EpochManager::instance().retire(local_descriptor, Descriptor<T>::destroy);
+		complete(new_descriptor, false);
+	}
+
+	// Function to complete any pending writes
+	// helping is true if the write belongs to another thread, in which case a completed write is counted as helped.
+	void complete_write(WriteDesc<T> *writeop, bool helping = true) {
+		// Skip if the pending is false for the write operation or it's NULL
+		if(writeop != NULL && writeop->pending.load(VECTOR_ORDER(acquire))) {
+			bool written = false;
+			for(long long i = 0; i < writeop->count; i++) {
+				stored_type old_value = writeop->old_values[i];
+				// We atomically swap the old value with the new value to be written. Only one of the helping threads succeeds with the
+				// swap, since the slot no longer holds the old value afterwards, unless a later push put an equal value back (ABA, see
+				// ElementStorage).
+				// Only a helper working from a replaced descriptor can find the bucket released, and the write is done by then
+				location *slot = find(writeop->position + i);
+				if(slot != NULL && slot->compare_exchange_strong(old_value, writeop->new_values[i], VECTOR_ORDER(release),
+						VECTOR_ORDER(relaxed)))
+					written = true;
+			}
+			if(helping && written)
+				counters.add(ContentionCounters::HELPED_WRITES);
+			// Mark the write operation as complete by setting the pending flag to false
+			writeop->pending.store(false, VECTOR_ORDER(release));
+		}
+	}
+
+	// Function to allocate the zeroed memory of a bucket, or to map it from the data file
+	/* A zeroed slot holds a value-initialized atomic, 0 for numbers and NULL for pointers, and the slots are only ever read as the old
+	 * value of a write or released by the destructor. calloc() hands large blocks straight from fresh mapped pages without touching
+	 * them, so a bucket only costs the memory that has actually been pushed to. Large buckets mapped by the allocator's policy and
+	 * the buckets of a new data file, which are holes in the file, read as zeros as well.
+	 */
+	location *new_bucket(int bucket) {
+		if(file != NULL)
+			return (location *)file->map(bucket);
+		return (location *)allocator.allocate(bucket_size(bucket) * sizeof(location));
+	}
+
+	void free_bucket(int bucket, location *array) {
+		if(file != NULL)
+			file->unmap(bucket, array);
+		else
+			allocator.deallocate(array, bucket_size(bucket) * sizeof(location));
+	}
+
+	// Function to get the length of the mapping of a bucket, 0 if it comes from calloc()
+	size_t mapped_length(int bucket) {
+		if(file != NULL)
+			return file->mapped_length(bucket);
+		return allocator.mapped_length(bucket_size(bucket) * sizeof(location));
+	}
+
+	// Function to take the buckets of a shrink out of the bucket table
+	// Each bucket is only taken out if the table still holds the one recorded by the shrink, so helpers can repeat this harmlessly.
+	void complete_shrink(ShrinkDesc<T> *op) {
+		if(op == NULL || !op->pending.load(VECTOR_ORDER(acquire)))
+			return;
+		// Taking a bucket out publishes nothing by itself. Threads that find the shrink done see the empty entries through the
+		// release of pending, and others complete the shrink themselves before touching the table.
+		for(int i = 0; i < op->count; i++) {
+			location *array = op->arrays[i];
+			memory[op->first + i].compare_exchange_strong(array, NULL, VECTOR_ORDER(relaxed));
+		}
+		op->pending.store(false, VECTOR_ORDER(release));
+	}
+
+	// Function to release the buckets at and above a given one
+	/* The release is published by swapping in a descriptor of the same size that carries the buckets to release, so it is ordered
+	 * with the pushes and pops like any other operation and is completed by whoever finds it pending. keep(size) gives the first
+	 * bucket to release for the size of the descriptor being replaced, and is recomputed on every attempt. A push that later reaches
+	 * a released bucket allocates a new one. Returns without retrying if try_once is set and the swap fails.
+	 */
+	template<typename Keep>
+	void shrink(Keep keep, bool try_once) {
+		EpochGuard guard;
+#ifdef VECTOR_WAIT_FREE
+		help_announced();
+#endif
+		while(true) {
+			// The pending write of the replaced descriptor is completed here, as the new one does not carry it
+			Descriptor<T> *local_descriptor = current_descriptor();
+			int first = std::max(keep(local_descriptor->size), 1);
+			ShrinkDesc<T> *op = NULL;
+			for(int bucket = first; bucket < BUCKETS; bucket++) {
+				location *array = memory[bucket].load(VECTOR_ORDER(acquire));
+				if(array == NULL)
+					continue;
+				if(op == NULL)
+					op = new ShrinkDesc<T>(bucket);
+				// Buckets are recorded in order, so a hole left by an earlier shrink is recorded as an empty entry
+				while(op->first + op->count < bucket)
+					op->arrays[op->count++] = NULL;
+				op->arrays[op->count] = array;
+				op->slots[op->count] = bucket_size(bucket);
+				op->lengths[op->count++] = mapped_length(bucket);
+			}
+			if(op == NULL)
+				return;
+			Descriptor<T> *new_descriptor = ObjectPool<Descriptor<T> >::allocate(local_descriptor->size, (WriteDesc<T> *)NULL);
+			new_descriptor->pops = local_descriptor->pops;
+			new_descriptor->shrink_op = op;
+			if(descriptor.compare_exchange_strong(local_descriptor, new_descriptor, VECTOR_ORDER(seq_cst), VECTOR_ORDER(relaxed))) {
+				EpochManager::instance().retire(local_descriptor, Descriptor<T>::destroy);
+				complete(new_descriptor, false);
+				return;
+			}
+			delete op;
+			ObjectPool<Descriptor<T> >::deallocate(new_descriptor);
+			if(try_once)
+				return;
+		}
+	}
+
+	// Function to release the buckets that a pop has left well above the size of the vector
+	/* The bucket the next push goes to and the one above it are kept, so a vector that hovers around a bucket boundary does not keep
+	 * releasing and allocating the same bucket. A bucket is only released once the size has dropped below half of its first index.
+	 * Checking whether the bucket two above is still there keeps this to a single load on most pops.
+	 */
+	void release_unused(long long size) {
+		int first = bucket_of(size) + 2;
+		if(first >= BUCKETS || memory[first].load(VECTOR_ORDER(relaxed)) == NULL)
+			return;
+		shrink([this](long long s) {return bucket_of(s) + 2;}, true);
+	}
+
+	// Function to allocate a new bucket
+	void alloc_bucket(int bucket) {
+		// For some strange reason, we need to copy the atomic object to a local variable before applying CAS
+		// Else, you get this error;
+		// error: invalid initialization of non-const reference of type ‘std::__atomic_base<int>::__int_type& {aka int&}’
+		// from an rvalue of type ‘std::__atomic_base<int>::__int_type {aka int}’
+		location *temp_memory = memory[bucket].load(VECTOR_ORDER(relaxed));
+		location *array = new_bucket(bucket);
+		// Release makes the zeroed bucket visible to the threads that acquire it from the table
+		if(!memory[bucket].compare_exchange_strong(temp_memory, array, VECTOR_ORDER(release), VECTOR_ORDER(relaxed))) {
+			free_bucket(bucket, array);
+			counters.add(ContentionCounters::BUCKET_RACES_LOST);
+		}
+	}
+
+	// Consistent copy of the elements of a vector, as returned by snapshot()
+	class Snapshot {
+		friend class Vector;
+		std::vector<T> elements;
+	public:
+		typedef typename std::vector<T>::const_iterator iterator;
+		iterator begin() const {return elements.begin();}
+		iterator end() const {return elements.end();}
+		size_t size() const {return elements.size();}
+		const T &operator[](size_t i) const {return elements[i];}
+	};
+
+	// Function to take a linearizable copy of the vector's elements
+	/* The copy holds [0, size) of a single descriptor, including the element of its pending write, and is linearized at the point
+	 * that descriptor was loaded. The buckets are copied by the given no. of threads. A copy that a concurrent pop invalidates is
+	 * taken again, which only happens if the vector shrinks during the copy. Elements updated in place with write() or
+	 * compare_exchange() during the copy are seen either before or after the update. T has to be default constructible.
+	 */
+	Snapshot snapshot(int threads = 1) {
+		EpochGuard guard;
+		Snapshot result;
+		std::vector<Piece> parts;
+		auto copy = [&](size_t, const Piece &piece) {
+			for(long long i = 0; i < piece.count; i++)
+				result.elements[piece.first + i] = storage::peek(piece.slots[i].load(storage::read_order));
+		};
+		auto prepare = [&](long long size, size_t) {
+			result.elements.clear();
+			result.elements.resize(size);
+		};
+		while(!scan(threads, parts, prepare, copy));
+		return result;
+	}
+
+	// Function to call f on every element of a linearizable view of the vector, split across the given no. of threads
+	// The view is taken with snapshot() first, so f is called exactly once per element even if the vector shrinks meanwhile. The
+	// calls are made concurrently by different threads and in no particular order.
+	template<typename F>
+	void for_each(F f, int threads = 1) {
+		Snapshot view = snapshot(threads);
+		std::vector<Piece> parts = pieces(view.size(), threads);
+		std::atomic<size_t> next(0);
+		auto worker = [&]() {
+			for(size_t p = next++; p < parts.size(); p = next++) {
+				for(long long i = parts[p].first; i < parts[p].first + parts[p].count; i++)
+					f(view.elements[i]);
+			}
+		};
+		run_parallel(std::min(threads, (int)parts.size()), worker);
+	}
+
+	// Function to combine init with every element of a linearizable view of the vector, split across the given no. of threads
+	/* Every thread combines the pieces it takes and the partial results are combined at the end, so op has to be associative and
+	 * commutative, like std::reduce(). Nothing is copied, the elements are read straight from the buckets, and the reduction is
+	 * simply redone if a concurrent pop invalidates it.
+	 */
+	template<typename BinaryOp>
+	T reduce(T init, BinaryOp op, int threads = 1) {
+		EpochGuard guard;
+		std::vector<Piece> parts;
+		std::vector<std::optional<T> > partials;
+		auto combine = [&](size_t p, const Piece &piece) {
+			T result = storage::peek(piece.slots[0].load(storage::read_order));
+			for(long long i = 1; i < piece.count; i++)
+				result = op(result, storage::peek(piece.slots[i].load(storage::read_order)));
+			partials[p] = std::move(result);
+		};
+		auto prepare = [&](long long, size_t count) {
+			partials.clear();
+			partials.resize(count);
+		};
+		while(!scan(threads, parts, prepare, combine));
+		T result = init;
+		for(size_t p = 0; p < parts.size(); p++)
+			result = op(result, *partials[p]);
+		return result;
+	}
+
+	// Function to find the index of the first element equal to value in a linearizable view of the vector, -1 if there is none
+	/* The buckets are searched piece by piece, split across the given no. of threads. Pieces are handed out in index order, so a
+	 * piece that starts past a match that has already been found is skipped.
+	 */
+	long long index_of(const T &value, int threads = 1) {
+		EpochGuard guard;
+		std::vector<Piece> parts;
+		std::atomic<long long> best(LLONG_MAX);
+		auto search = [&](size_t, const Piece &piece) {
+			if(piece.first >= best.load(VECTOR_ORDER(relaxed)))
+				return;
+			long long i = find_in(piece, value);
+			if(i < 0)
+				return;
+			long long current = best.load(VECTOR_ORDER(relaxed));
+			while(piece.first + i < current && !best.compare_exchange_weak(current, piece.first + i, VECTOR_ORDER(relaxed)));
+		};
+		auto prepare = [&](long long, size_t) {
+			best = LLONG_MAX;
+		};
+		while(!scan(threads, parts, prepare, search));
+		return best == LLONG_MAX ? -1 : best.load();
+	}
+
+	// Function to count the elements equal to value in a linearizable view of the vector, split across the given no. of threads
+	long long count(const T &value, int threads = 1) {
+		EpochGuard guard;
+		std::vector<Piece> parts;
+		std::vector<long long> partials;
+		auto tally = [&](size_t p, const Piece &piece) {
+			partials[p] = count_in(piece, value);
+		};
+		auto prepare = [&](long long, size_t count) {
+			partials.assign(count, 0);
+		};
+		while(!scan(threads, parts, prepare, tally));
+		long long total = 0;
+		for(size_t p = 0; p < partials.size(); p++)
+			total += partials[p];
+		return total;
+	}
+
+	// Function to count the elements of a linearizable view of the vector that satisfy pred, split across the given no. of threads
+	// pred is called concurrently by different threads, and possibly more than once per element if a concurrent pop forces a rescan.
+	template<typename Predicate>
+	long long count_if(Predicate pred, int threads = 1) {
+		EpochGuard guard;
+		std::vector<Piece> parts;
+		std::vector<long long> partials;
+		auto tally = [&](size_t p, const Piece &piece) {
+			partials[p] = count_in_if(piece, pred);
+		};
+		auto prepare = [&](long long, size_t count) {
+			partials.assign(count, 0);
+		};
+		while(!scan(threads, parts, prepare, tally));
+		long long total = 0;
+		for(size_t p = 0; p < partials.size(); p++)
+			total += partials[p];
+		return total;
+	}
+
+	// Functions to get the smallest and the largest element of a linearizable view of the vector, empty if the vector is empty
+	// Elements are compared with operator<.
+	std::optional<T> min(int threads = 1) {
+		std::optional<std::pair<T, T> > bounds = minmax(threads);
+		return bounds ? std::optional<T>(bounds->first) : std::nullopt;
+	}
+
+	std::optional<T> max(int threads = 1) {
+		std::optional<std::pair<T, T> > bounds = minmax(threads);
+		return bounds ? std::optional<T>(bounds->second) : std::nullopt;
+	}
+
+	// Function to display the contents of the vector
+	void display() {
+		Snapshot view = snapshot();
+		for(size_t i = 0; i < view.size(); i++)
+			std::cout << view[i] << " ";
+		std::cout << std::endl;
+	}
+
+	// Function to pop an element from the back of the arraylist
+	// The pop_back() operation uses a similar helping approach as the push_back() operation by completing any pending writes before
+	// popping the element and swapping in a new descriptor with size-1. An empty optional is returned if the vector is empty.
+	std::optional<T> pop_back() {
+		EpochGuard guard;
+		Descriptor<T> *local_descriptor;
+		Descriptor<T> *new_descriptor = ObjectPool<Descriptor<T> >::allocate(0, (WriteDesc<T> *)NULL);
+		stored_type data;
+		bool eliminated = false;
+		int attempts = 0;
+#ifdef VECTOR_WAIT_FREE
+		help_announced();
+#endif
+		do {
+#ifdef VECTOR_WAIT_FREE
+			// After too many failed swaps, announce the pop and let the other threads help it complete
+			if(attempts == FAST_PATH_ATTEMPTS) {
+				counters.add(ContentionCounters::POP_CAS_FAILURES, attempts);
+				counters.operation(attempts);
+				return announce_pop(new_descriptor);
+			}
+#endif
+			attempts++;
+			local_descriptor = descriptor.load(VECTOR_ORDER(acquire));
+			complete(local_descriptor, true);
+			// The vector might have been emptied by other threads since the last attempt. A concurrent push may still be offering its
+			// element, in which case the pair is linearized as a push immediately followed by this pop.
+			if(local_descriptor->size == 0) {
+				counters.add(ContentionCounters::POP_CAS_FAILURES, attempts - 1);
+				counters.operation(attempts - 1);
+				ObjectPool<Descriptor<T> >::deallocate(new_descriptor);
+				if(try_eliminate_pop(data))
+					return take_eliminated(data);
+				return std::nullopt;
+			}
+			// The slot is only missing if the descriptor has been replaced, in which case the swap below fails
+			location *slot = find(local_descriptor->size-1);
+			data = slot != NULL ? slot->load(storage::read_order) : stored_type();
+			new_descriptor->size = local_descriptor->size-1;
+			new_descriptor->pops = local_descriptor->pops + 1;
+			// The following compare_exchange_weak() is the linearization point for the pop_back() operation with respect to the other
+			// push and pop operations. If this atomic swap failed, then that means another another had changed the state of the vector
+			// since the time the current thread obtained a local copy of the vector's descriptor.
+		} while(!descriptor.compare_exchange_weak(local_descriptor, new_descriptor, VECTOR_ORDER(seq_cst), VECTOR_ORDER(relaxed)) && !(eliminated = try_eliminate_pop(data)));
+		counters.add(ContentionCounters::POP_CAS_FAILURES, eliminated ? attempts : attempts - 1);
+		counters.operation(attempts - 1);
+		if(eliminated) {
+			ObjectPool<Descriptor<T> >::deallocate(new_descriptor);
+			return take_eliminated(data);
+		}
+		EpochManager::instance().retire(local_descriptor, Descriptor<T>::destroy);
+		release_unused(new_descriptor->size);
+		// Only the thread that popped the element can take it. It is left in its slot until a later push replaces it.
+		return storage::take(data);
+	}
+
+	// Function to pop up to k elements from the back of the arraylist with a single descriptor swap
+	// The elements are written to out in the order successive pop_back() calls would return them, i.e. the last element first. The
+	// no. of elements popped is returned, which is less than k if the vector held fewer elements.
+	template<typename OutputIt>
+	long long pop_back_n(OutputIt out, long long k) {
+		if(k <= 0)
+			return 0;
+		// The elements have to be read before the swap, as the positions can be reused by other threads right after it
+		static thread_local std::vector<stored_type> data;
+		EpochGuard guard;
+		Descriptor<T> *local_descriptor;
+		Descriptor<T> *new_descriptor = ObjectPool<Descriptor<T> >::allocate(0, (WriteDesc<T> *)NULL);
+		long long count;
+		int attempts = 0;
+#ifdef VECTOR_WAIT_FREE
+		help_announced();
+#endif
+		do {
+			attempts++;
+			local_descriptor = descriptor.load(VECTOR_ORDER(acquire));
+			complete(local_descriptor, true);
+			count = std::min(k, local_descriptor->size);
+			if(count == 0) {
+				counters.add(ContentionCounters::POP_CAS_FAILURES, attempts - 1);
+				counters.operation(attempts - 1);
+				ObjectPool<Descriptor<T> >::deallocate(new_descriptor);
+				return 0;
+			}
+			data.resize(count);
+			for(long long i = 0; i < count; i++) {
+				location *slot = find(local_descriptor->size - 1 - i);
+				data[i] = slot != NULL ? slot->load(storage::read_order) : stored_type();
+			}
+			new_descriptor->size = local_descriptor->size - count;
+			new_descriptor->pops = local_descriptor->pops + 1;
+		} while(!descriptor.compare_exchange_weak(local_descriptor, new_descriptor, VECTOR_ORDER(seq_cst), VECTOR_ORDER(relaxed)));
+		counters.add(ContentionCounters::POP_CAS_FAILURES, attempts - 1);
+		counters.operation(attempts - 1);
+		EpochManager::instance().retire(local_descriptor, Descriptor<T>::destroy);
+		release_unused(new_descriptor->size);
+		for(long long i = 0; i < count; i++, ++out)
+			*out = storage::take(data[i]);
+		return count;
+	}
+
+	// Function to release every bucket above the one holding the last element
+	/* Unlike the release after a pop, this does not keep any spare capacity. The buckets are freed once no thread can still be using
+	 * them, which for the calling thread is right away: the descriptor carrying the release is replaced by an unchanged one, and the
+	 * epoch manager is then given the chance to reclaim it. Other threads that are in the middle of an operation delay this until
+	 * they finish it. Must not be called from inside an operation on a vector, e.g. from for_each().
+	 */
+	void shrink_to_fit() {
+		shrink([this](long long s) {return s == 0 ? 1 : bucket_of(s - 1) + 1;}, false);
+		{
+			EpochGuard guard;
+			Descriptor<T> *local_descriptor;
+			Descriptor<T> *new_descriptor = ObjectPool<Descriptor<T> >::allocate(0, (WriteDesc<T> *)NULL);
+			do {
+				local_descriptor = descriptor.load(VECTOR_ORDER(acquire));
+				complete(local_descriptor, true);
+				new_descriptor->size = local_descriptor->size;
+				new_descriptor->pops = local_descriptor->pops;
+			} while(!descriptor.compare_exchange_weak(local_descriptor, new_descriptor, VECTOR_ORDER(seq_cst), VECTOR_ORDER(relaxed)));
+			EpochManager::instance().retire(local_descriptor, Descriptor<T>::destroy);
+		}
+		EpochManager::instance().reclaim();
+	}
+
+	// Function to get the no. of buckets that asked for explicit huge pages but had to use transparent ones
+	long huge_page_fallbacks() {
+		return allocator.huge_page_fallbacks();
+	}
+
+	// Function to get the no. of push/pop pairs that were eliminated, 0 if elimination is disabled
+	long eliminated_count() {
+		return elimination != NULL ? elimination->eliminated_count() : 0;
+	}
+
+	// Function to get a snapshot of the contention counters, summed over all threads
+	// All the counters are zero unless the vector is compiled with -DVECTOR_STATS.
+	VectorStats stats() {
+		return counters.snapshot();
+	}
+
+	// Function to check if the arraylist is empty
+	/* This function is wait-free as we can define the linearization point as the point at which the local copy of the descriptor
+	 * is successfully compared to the value 0.
+	 */
+	bool isEmpty() {
+		EpochGuard guard;
+		Descriptor<T> *local_descriptor = descriptor.load(VECTOR_ORDER(acquire));
+		return local_descriptor->size == 0;
+	}
+};
+
+#endif
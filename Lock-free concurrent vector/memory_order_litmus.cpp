@@ -0,0 +1,210 @@
+/*
+ * Litmus tests of the memory orderings of the lock-free concurrent vector. Each test stresses one of the edges that the weakened
+ * orderings still have to provide, and checks that the threads relying on that edge see the elements they were promised.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <pthread.h>
+#include <getopt.h>
+#include "lock_free_vector.hpp"
+
+/* Elements are strings, which the vector keeps in heap nodes that are constructed before their pointer is published. So besides the
+ * values being checked, a missing happens-before edge shows up as a data race on a node when the tests run under ThreadSanitizer.
+ */
+typedef Vector<std::string> StringVector;
+
+// Arguments of the threads of a test
+struct LitmusArguments {
+	StringVector *vector;
+	long long elements;
+	int batch;
+	int id;
+	std::atomic<bool> *done;
+	std::atomic<long long> *errors;
+	// Elements popped by this thread in the bucket test, by the thread that pushed them
+	std::vector<long long> popped;
+};
+
+// Function to get the value pushed at a given index by the tests with a single pusher
+std::string value_at(long long i) {
+	return std::to_string(i);
+}
+
+// Function to get the next pseudo-random number of a reader
+unsigned int next_random(unsigned int &seed) {
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+// Function run by the single pusher of the message passing and descriptor tests
+void *push_worker(void *ptr) {
+	LitmusArguments *args = (LitmusArguments *)ptr;
+	std::vector<std::string> batch;
+	for(long long i = 0; i < args->elements; i += args->batch) {
+		batch.clear();
+		for(long long j = i; j < i + args->batch; j++)
+			batch.push_back(value_at(j));
+		if(args->batch == 1)
+			args->vector->push_back(batch[0]);
+		else
+			args->vector->push_back_n(batch.begin(), batch.end());
+	}
+	args->done->store(true);
+	return NULL;
+}
+
+// Function run by the readers of the message passing test
+/* size() only counts the last push once it has loaded its pending flag as false, and nothing but that flag orders the relaxed load
+ * of the slot below after the write to it. Without the release and acquire pair, the slot could still read as NULL. The node itself
+ * is ordered by the descriptor swap, so this edge only carries the slot value: ThreadSanitizer does not model stale loads and cannot
+ * see it missing, and x86 never reorders the two loads, so only the value check on a weakly ordered CPU such as ARM catches it.
+ */
+void *pending_reader(void *ptr) {
+	LitmusArguments *args = (LitmusArguments *)ptr;
+	while(!args->done->load()) {
+		long long size = args->vector->size();
+		if(size == 0)
+			continue;
+		std::string *node = args->vector->at(size - 1)->load(std::memory_order_relaxed);
+		if(node == NULL || *node != value_at(size - 1))
+			args->errors->fetch_add(1);
+	}
+	return NULL;
+}
+
+// Function run by the readers of the descriptor test
+/* read() completes the pending write of the descriptor it loads before reading the element, so the readers keep helping the batches
+ * of the pusher. A helper only learns the position and the values of a batch through the descriptor, which it loads with acquire.
+ */
+void *helping_reader(void *ptr) {
+	LitmusArguments *args = (LitmusArguments *)ptr;
+	unsigned int seed = 2463534242u + args->id;
+	while(!args->done->load()) {
+		long long size = args->vector->size();
+		if(size == 0)
+			continue;
+		// Mostly the elements of the last batch, which are the ones still being written
+		unsigned int r = next_random(seed);
+		long long i = r % 4 != 0 ? std::max(0LL, size - 1 - (long long)(r / 4 % args->batch)) : (long long)(r / 4 % size);
+		std::optional<std::string> value = args->vector->read(i);
+		if(!value.has_value() || *value != value_at(i))
+			args->errors->fetch_add(1);
+	}
+	return NULL;
+}
+
+// Function to count a popped element of the bucket test against the thread that pushed it
+void count_popped(LitmusArguments *args, const std::optional<std::string> &value) {
+	size_t colon = value.has_value() ? value->find(':') : std::string::npos;
+	int origin = colon != std::string::npos ? atoi(value->c_str()) : -1;
+	if(origin < 0 || origin >= (int)args->popped.size()) {
+		args->errors->fetch_add(1);
+		return;
+	}
+	args->popped[origin]++;
+}
+
+// Function run by every thread of the bucket test
+/* The threads push and pop in rounds from an empty vector, so the buckets are given back by the pops and raced for again by the next
+ * pushes. A thread that loses the race for a bucket reads the old value of its slot through the bucket published by the winner, and
+ * the pops read the elements through the bucket table. Values are tagged with their thread, and the counts are checked at the end.
+ */
+void *bucket_worker(void *ptr) {
+	LitmusArguments *args = (LitmusArguments *)ptr;
+	for(long long i = 0; i < args->elements; i += args->batch) {
+		for(long long j = i; j < i + args->batch; j++)
+			args->vector->push_back(std::to_string(args->id) + ":" + value_at(j));
+		for(int j = 0; j < args->batch; j++)
+			count_popped(args, args->vector->pop_back());
+	}
+	return NULL;
+}
+
+// Function to run a test with the given worker in every thread, and to get its no. of errors
+/* If pusher is set, the first thread pushes the elements and the others read them until it is done. Otherwise every thread runs
+ * the worker, which is the bucket test, and the elements each thread pushed are checked to have been popped exactly once.
+ */
+long long run_test(void *(*worker)(void *), bool pusher, int threads, long long elements, int batch) {
+	StringVector v;
+	std::atomic<bool> done(false);
+	std::atomic<long long> errors(0);
+	std::vector<LitmusArguments> args(threads);
+	std::vector<pthread_t> thread(threads);
+	for(int i = 0; i < threads; i++) {
+		args[i].vector = &v;
+		args[i].elements = elements;
+		args[i].batch = batch;
+		args[i].id = i;
+		args[i].done = &done;
+		args[i].errors = &errors;
+		args[i].popped.assign(threads, 0);
+	}
+	for(int i = 0; i < threads; i++)
+		pthread_create(&thread[i], NULL, pusher && i == 0 ? push_worker : worker, &args[i]);
+	for(int i = 0; i < threads; i++)
+		pthread_join(thread[i], NULL);
+	if(pusher)
+		return errors.load();
+	// Whatever the rounds left in the vector is counted as well
+	while(v.size() > 0)
+		count_popped(&args[0], v.pop_back());
+	for(int origin = 0; origin < threads; origin++) {
+		long long total = 0;
+		for(int i = 0; i < threads; i++)
+			total += args[i].popped[origin];
+		long long expected = (elements + batch - 1) / batch * batch;
+		if(total != expected)
+			errors += total > expected ? total - expected : expected - total;
+	}
+	return errors.load();
+}
+
+// Main function
+int main(int argc, char **argv) {
+	long long elements = 200000;
+	int threads = 4;
+	int batch = 16;
+	int c;
+	while((c = getopt(argc, argv, "n:t:b:")) != -1) {
+		switch(c) {
+		case 'n': elements = atoll(optarg); break;
+		case 't': threads = atoi(optarg); break;
+		case 'b': batch = atoi(optarg); break;
+		default:
+			std::cerr << "Usage: " << argv[0] << " [-n elements per test] [-t threads] [-b batch size]" << std::endl;
+			return 1;
+		}
+	}
+	if(elements < 1 || threads < 2 || batch < 1) {
+		std::cerr << "The elements and the batch size have to be positive, and at least 2 threads are needed" << std::endl;
+		return 1;
+	}
+
+	struct {
+		const char *name;
+		void *(*worker)(void *);
+		bool pusher;
+		int batch;
+	} tests[] = {
+		{"pending flag -> slot value", pending_reader, true, 1},
+		{"bucket publish -> element read", bucket_worker, false, batch},
+		{"descriptor swap -> complete_write", helping_reader, true, batch},
+	};
+	std::cout << elements << " elements per test, " << threads << " threads, batches of " << batch
+#ifdef VECTOR_SEQ_CST
+		<< ", seq_cst orderings"
+#endif
+		<< std::endl;
+	long long failed = 0;
+	for(auto &test : tests) {
+		long long errors = run_test(test.worker, test.pusher, threads, elements, test.batch);
+		std::cout << test.name << ": " << (errors == 0 ? "ok" : "FAILED, " + std::to_string(errors) + " errors") << std::endl;
+		failed += errors != 0;
+	}
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,19 @@
+/*
+ * Memory orderings of the lock-free concurrent vector and its epoch manager.
+ */
+
+#ifndef MEMORY_ORDERS_HPP
+#define MEMORY_ORDERS_HPP
+
+#include <atomic>
+
+// Every ordering the vector and the epoch manager use is written as VECTOR_ORDER(name), e.g. VECTOR_ORDER(acquire), so that
+// compiling with -DVECTOR_SEQ_CST makes all of them seq_cst again, as they were before they were weakened. The two builds are
+// compared by bench_orderings.sh, and the litmus tests in memory_order_litmus.cpp run against either of them.
+#ifdef VECTOR_SEQ_CST
+#define VECTOR_ORDER(order) std::memory_order_seq_cst
+#else
+#define VECTOR_ORDER(order) std::memory_order_##order
+#endif
+
+#endif
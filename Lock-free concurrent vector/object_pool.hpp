@@ -0,0 +1,270 @@
+
+/*
+ * Thread-local object pools for the descriptors and write operations of the lock-free concurrent vector, and for the arrays of
+ * values of its batch writes.
+ */
+
+#ifndef OBJECT_POOL_HPP
+#define OBJECT_POOL_HPP
+
+#include <atomic>
+#include <vector>
+#include <new>
+#include <utility>
+#include <mutex>
+#include <algorithm>
+
+// Thread-local pool of objects of a given type
+/* Every thread keeps its own free list, so allocating and freeing does not touch shared state. Objects freed by the epoch manager are
+ * returned to the pool of the thread that collected them, which is the thread that retired them. The flows are not always balanced
+ * though: a thread that only pushes allocates a write operation per push but often retires descriptors created by pops, which have
+ * none. So a thread whose free list grows too long moves a batch of objects to a shared depot, and a thread that runs out takes a
+ * batch from it before falling back to the heap. The depot is only ever try-locked, so a stalled thread cannot block the others,
+ * which simply use the heap instead.
+ */
+template<typename O>
+class ObjectPool {
+
+	// Max. no. of free objects a thread keeps before moving a batch to the depot
+	static const size_t MAX_CACHED = 16384;
+	// No. of objects moved between a thread and the depot at a time
+	static const size_t BATCH_SIZE = 1024;
+	// Max. no. of batches kept in the depot, the rest are handed back to the heap
+	static const size_t MAX_DEPOT_BATCHES = 256;
+
+	// Per-thread free list, aligned to its own cache line
+	struct alignas(64) Cache {
+		std::vector<void *> free;
+		long heap_allocations;
+		Cache() : heap_allocations(0) {}
+		// Hands the free objects over to the depot when the thread exits, so that threads started later can reuse them
+		~Cache() {
+			while(free.size() >= BATCH_SIZE)
+				give_batch(*this);
+			for(size_t i = 0; i < free.size(); i++)
+				::operator delete(free[i], std::align_val_t(alignof(O)));
+			total_heap_allocations.fetch_add(heap_allocations, std::memory_order_relaxed);
+			destroyed() = true;
+		}
+	};
+
+	// Heap allocations made by threads that have exited
+	static inline std::atomic<long> total_heap_allocations{0};
+
+	// Shared depot of batches of free objects, which are handed back to the heap when the program exits
+	struct Depot : std::vector<std::vector<void *> > {
+		~Depot() {
+			for(size_t i = 0; i < size(); i++) {
+				for(size_t j = 0; j < (*this)[i].size(); j++)
+					::operator delete((*this)[i][j], std::align_val_t(alignof(O)));
+			}
+		}
+	};
+	static inline std::mutex depot_lock;
+	static inline Depot depot;
+
+	// Function to refill an empty free list with a batch from the depot
+	static bool take_batch(Cache &c) {
+		std::unique_lock<std::mutex> lock(depot_lock, std::try_to_lock);
+		if(!lock.owns_lock() || depot.empty())
+			return false;
+		c.free.swap(depot.back());
+		depot.pop_back();
+		return true;
+	}
+
+	// Function to move a batch of objects from a full free list to the depot
+	static void give_batch(Cache &c) {
+		std::vector<void *> batch(c.free.end() - BATCH_SIZE, c.free.end());
+		c.free.resize(c.free.size() - BATCH_SIZE);
+		std::unique_lock<std::mutex> lock(depot_lock, std::try_to_lock);
+		if(lock.owns_lock() && depot.size() < MAX_DEPOT_BATCHES) {
+			depot.push_back(std::move(batch));
+			return;
+		}
+		for(size_t i = 0; i < batch.size(); i++)
+			::operator delete(batch[i], std::align_val_t(alignof(O)));
+	}
+
+	static Cache &cache() {
+		static thread_local Cache c;
+		return c;
+	}
+
+	// Flag that is set once the calling thread's cache has been destroyed. Objects retired by a thread can still be freed while it
+	// exits, after its cache is gone, in which case they go straight back to the heap.
+	static bool &destroyed() {
+		static thread_local bool flag = false;
+		return flag;
+	}
+
+public:
+	// Function to construct an object, reusing a free one if the calling thread has any
+	template<typename... Args>
+	static O *allocate(Args&&... args) {
+		void *memory;
+		if(!destroyed() && (!cache().free.empty() || take_batch(cache()))) {
+			memory = cache().free.back();
+			cache().free.pop_back();
+		}
+		else {
+			memory = ::operator new(sizeof(O), std::align_val_t(alignof(O)));
+			if(!destroyed())
+				cache().heap_allocations++;
+			else
+				total_heap_allocations.fetch_add(1, std::memory_order_relaxed);
+		}
+		return new(memory) O(std::forward<Args>(args)...);
+	}
+
+	// Function to destroy an object and keep its memory in the calling thread's pool
+	static void deallocate(O *object) {
+		if(object == NULL)
+			return;
+		object->~O();
+		if(destroyed()) {
+			::operator delete(object, std::align_val_t(alignof(O)));
+			return;
+		}
+		Cache &c = cache();
+		if(c.free.size() >= MAX_CACHED)
+			give_batch(c);
+		c.free.push_back(object);
+	}
+
+	// Function to get the no. of objects allocated from the heap by the threads that have exited and the calling thread
+	static long heap_allocations() {
+		return total_heap_allocations.load() + (destroyed() ? 0 : cache().heap_allocations);
+	}
+};
+
+// Thread-local pool of arrays of a given element type, such as the values of a batch write
+/* Arrays are kept in power of 2 size classes, so a batch reuses any freed array of its class and only its first n elements are
+ * used. Like objects, arrays freed by the epoch manager go back to the pool of the thread that collected them, and the free lists of
+ * a class are balanced between threads through a depot the same way. A thread keeps about MAX_CACHED_ELEMENTS elements' worth of
+ * arrays per class. Arrays larger than the largest class always come from the heap, as such batches are rare and their own cost
+ * outweighs the allocation.
+ */
+template<typename E>
+class ArrayPool {
+
+	// No. of size classes, the largest of which holds arrays of 1 << (CLASSES - 1) elements
+	static const int CLASSES = 17;
+	static const size_t MAX_CACHED_ELEMENTS = 1 << 16;
+	// Max. no. of batches of each class kept in the depot
+	static const size_t MAX_DEPOT_BATCHES = 64;
+
+	struct alignas(64) Cache {
+		std::vector<E *> free[CLASSES];
+		long heap_allocations;
+		Cache() : heap_allocations(0) {}
+		~Cache() {
+			for(int c = 0; c < CLASSES; c++) {
+				while(free[c].size() >= batch_size(c))
+					give_batch(free[c], c);
+				for(size_t i = 0; i < free[c].size(); i++)
+					delete[] free[c][i];
+			}
+			total_heap_allocations.fetch_add(heap_allocations, std::memory_order_relaxed);
+			destroyed() = true;
+		}
+	};
+
+	static inline std::atomic<long> total_heap_allocations{0};
+
+	struct Depot {
+		std::vector<std::vector<E *> > batches[CLASSES];
+		~Depot() {
+			for(int c = 0; c < CLASSES; c++) {
+				for(size_t i = 0; i < batches[c].size(); i++) {
+					for(size_t j = 0; j < batches[c][i].size(); j++)
+						delete[] batches[c][i][j];
+				}
+			}
+		}
+	};
+	static inline std::mutex depot_lock;
+	static inline Depot depot;
+
+	// Function to get the no. of arrays of a class moved between a thread and the depot at a time, half of what a thread keeps
+	static size_t batch_size(int c) {
+		return std::max<size_t>(1, (MAX_CACHED_ELEMENTS >> c) / 2);
+	}
+
+	static bool take_batch(std::vector<E *> &free, int c) {
+		std::unique_lock<std::mutex> lock(depot_lock, std::try_to_lock);
+		if(!lock.owns_lock() || depot.batches[c].empty())
+			return false;
+		free.swap(depot.batches[c].back());
+		depot.batches[c].pop_back();
+		return true;
+	}
+
+	static void give_batch(std::vector<E *> &free, int c) {
+		std::vector<E *> batch(free.end() - batch_size(c), free.end());
+		free.resize(free.size() - batch_size(c));
+		std::unique_lock<std::mutex> lock(depot_lock, std::try_to_lock);
+		if(lock.owns_lock() && depot.batches[c].size() < MAX_DEPOT_BATCHES) {
+			depot.batches[c].push_back(std::move(batch));
+			return;
+		}
+		for(size_t i = 0; i < batch.size(); i++)
+			delete[] batch[i];
+	}
+
+	static Cache &cache() {
+		static thread_local Cache c;
+		return c;
+	}
+
+	static bool &destroyed() {
+		static thread_local bool flag = false;
+		return flag;
+	}
+
+	// Function to get the size class of an array of n elements, CLASSES if it is too large for any
+	static int size_class(long long n) {
+		int c = 0;
+		while(c < CLASSES && (1LL << c) < n)
+			c++;
+		return c;
+	}
+
+public:
+	// Function to get an array of n value-initialized elements, reusing a free one of its class if the calling thread has any
+	static E *allocate(long long n) {
+		int c = size_class(n);
+		if(c < CLASSES && !destroyed() && (!cache().free[c].empty() || take_batch(cache().free[c], c))) {
+			E *array = cache().free[c].back();
+			cache().free[c].pop_back();
+			std::fill_n(array, n, E());
+			return array;
+		}
+		E *array = new E[c < CLASSES ? 1LL << c : n]();
+		if(!destroyed())
+			cache().heap_allocations++;
+		else
+			total_heap_allocations.fetch_add(1, std::memory_order_relaxed);
+		return array;
+	}
+
+	// Function to give back an array of n elements that was allocated with allocate(n)
+	static void deallocate(E *array, long long n) {
+		int c = size_class(n);
+		if(c == CLASSES || destroyed()) {
+			delete[] array;
+			return;
+		}
+		std::vector<E *> &free = cache().free[c];
+		if(free.size() >= 2 * batch_size(c))
+			give_batch(free, c);
+		free.push_back(array);
+	}
+
+	// Function to get the no. of arrays allocated from the heap by the threads that have exited and the calling thread
+	static long heap_allocations() {
+		return total_heap_allocations.load() + (destroyed() ? 0 : cache().heap_allocations);
+	}
+};
+
+#endif
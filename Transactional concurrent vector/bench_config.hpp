@@ -0,0 +1,37 @@
+
+/*
+ * Benchmark configuration of the transactional vector, matching the one of the RSTM benchmarks.
+ */
+
+#ifndef BENCH_CONFIG_HPP
+#define BENCH_CONFIG_HPP
+
+#include "tm.hpp"
+
+#ifdef TM_BACKEND_RSTM
+#include <common/platform.hpp>
+#include <common/locks.hpp>
+#include "bmconfig.hpp"
+#else
+#include <cstdint>
+
+// Structure with the fields of RSTM's benchmark configuration, whose constructor the benchmark defines
+struct Config {
+    const char *bmname;
+    uint32_t duration;
+    uint32_t execute;
+    uint32_t threads;
+    uint32_t nops_after_tx;
+    uint32_t elements;
+    uint32_t lookpct;
+    uint32_t inspct;
+    uint32_t sets;
+    uint32_t ops;
+    volatile uint32_t time;
+    volatile bool running;
+    volatile uint32_t txcount;
+    Config();
+};
+#endif
+
+#endif
@@ -0,0 +1,336 @@
+/*
+ * Benchmark of operations composed across several vectors, as transactions of the transactional vector against the same operations
+ * under a global lock and under a lock per vector, for a growing no. of threads.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <cstdlib>
+#include <pthread.h>
+#include <getopt.h>
+#include "tm.hpp"
+#include "transactional_vector.hpp"
+
+typedef std::chrono::steady_clock benchmark_clock;
+
+// Composed operations of the benchmark
+/* A transfer pops the tail of one vector and pushes it to another, a swap exchanges random elements of two vectors, an update
+ * adds to random elements of three vectors together, with deltas that sum up to 0, and a push-pop pushes an element to a vector,
+ * reads it back and pops it again. None of them changes the sum of all elements, which is checked after every run, and a push-pop
+ * that reads or pops anything but the element it pushed is counted as a mismatch.
+ */
+enum Operation {TRANSFER, SWAP, UPDATE, PUSH_POP};
+
+// Structure to hold an operation, drawn before it runs so that a transaction that restarts runs the same one
+struct ComposedOperation {
+    Operation operation;
+    int vector[3];
+    unsigned random[3];
+    int delta;
+};
+
+// Composition of the operations as transactions on the transactional vectors
+class TransactionalComposition {
+    std::vector<TransactionalVector *> vectors;
+
+public:
+    std::atomic<long> mismatches{0};
+
+    TransactionalComposition(int count, int elements) {
+        for(int i = 0; i < count; i++) {
+            vectors.push_back(new TransactionalVector());
+            for(int j = 0; j < elements; j++)
+                vectors[i]->push_back(j);
+        }
+    }
+
+    ~TransactionalComposition() {
+        for(TransactionalVector *vector : vectors)
+            delete vector;
+    }
+
+    void run(const ComposedOperation &op) {
+        TransactionalVector &a = *vectors[op.vector[0]], &b = *vectors[op.vector[1]], &c = *vectors[op.vector[2]];
+        switch(op.operation) {
+        case TRANSFER:
+            TransactionalVector::transfer(a, b);
+            break;
+        case SWAP:
+            TransactionalVector::atomically([&] {
+                long long a_size = a.get_size(), b_size = b.get_size();
+                if(a_size && b_size)
+                    TransactionalVector::swap(a, op.random[0] % a_size, b, op.random[1] % b_size);
+            });
+            break;
+        case UPDATE:
+            TransactionalVector::atomically([&] {
+                TransactionalVector *targets[3] = {&a, &b, &c};
+                long long indices[3];
+                bool present = true;
+                for(int k = 0; k < 3; k++) {
+                    long long size = targets[k]->get_size();
+                    present = present && size;
+                    indices[k] = size ? op.random[k] % size : 0;
+                }
+                // The same element may come up twice, so each one is read after the writes before it
+                for(int k = 0; present && k < 3; k++)
+                    targets[k]->write(indices[k], targets[k]->read(indices[k]) + (k < 2 ? op.delta : -2 * op.delta));
+            });
+            break;
+        case PUSH_POP: {
+            int read_back, popped;
+            TransactionalVector::atomically([&] {
+                long long size = a.get_size();
+                a.push_back(op.delta);
+                read_back = a.read(size);
+                popped = a.pop_back();
+            });
+            if(read_back != op.delta || popped != op.delta)
+                mismatches++;
+            break;
+        }
+        }
+    }
+
+    long long sum() {
+        long long total = 0;
+        for(TransactionalVector *vector : vectors) {
+            for(long long i = 0, size = vector->get_size(); i < size; i++)
+                total += vector->read(i);
+        }
+        return total;
+    }
+};
+
+// Composition of the operations on std::vector, under a single lock or under a lock per vector
+/* With a lock per vector, an operation takes the locks of the vectors it touches in the order of their indices, so that two
+ * operations never wait for each other's locks.
+ */
+template<bool GLOBAL>
+class LockComposition {
+    struct LockedVector {
+        std::mutex lock;
+        std::vector<int> data;
+    };
+
+    std::vector<LockedVector *> vectors;
+    std::mutex global_lock;
+
+public:
+    std::atomic<long> mismatches{0};
+
+    LockComposition(int count, int elements) {
+        for(int i = 0; i < count; i++) {
+            vectors.push_back(new LockedVector());
+            for(int j = 0; j < elements; j++)
+                vectors[i]->data.push_back(j);
+        }
+    }
+
+    ~LockComposition() {
+        for(LockedVector *vector : vectors)
+            delete vector;
+    }
+
+    void run(const ComposedOperation &op) {
+        int touched = op.operation == UPDATE ? 3 : op.operation == PUSH_POP ? 1 : 2;
+        int order[3] = {op.vector[0], op.vector[1], op.vector[2]};
+        std::sort(order, order + touched);
+        if(GLOBAL)
+            global_lock.lock();
+        else {
+            for(int k = 0; k < touched; k++) {
+                if(k == 0 || order[k] != order[k-1])
+                    vectors[order[k]]->lock.lock();
+            }
+        }
+        std::vector<int> &a = vectors[op.vector[0]]->data, &b = vectors[op.vector[1]]->data, &c = vectors[op.vector[2]]->data;
+        switch(op.operation) {
+        case TRANSFER:
+            if(!a.empty()) {
+                int data = a.back();
+                a.pop_back();
+                b.push_back(data);
+            }
+            break;
+        case SWAP:
+            if(!a.empty() && !b.empty())
+                std::swap(a[op.random[0] % a.size()], b[op.random[1] % b.size()]);
+            break;
+        case UPDATE:
+            if(!a.empty() && !b.empty() && !c.empty()) {
+                a[op.random[0] % a.size()] += op.delta;
+                b[op.random[1] % b.size()] += op.delta;
+                c[op.random[2] % c.size()] -= 2 * op.delta;
+            }
+            break;
+        case PUSH_POP: {
+            size_t size = a.size();
+            a.push_back(op.delta);
+            int read_back = a[size];
+            int popped = a.back();
+            a.pop_back();
+            if(read_back != op.delta || popped != op.delta)
+                mismatches++;
+            break;
+        }
+        }
+        if(GLOBAL)
+            global_lock.unlock();
+        else {
+            for(int k = touched - 1; k >= 0; k--) {
+                if(k == 0 || order[k] != order[k-1])
+                    vectors[order[k]]->lock.unlock();
+            }
+        }
+    }
+
+    long long sum() {
+        long long total = 0;
+        for(LockedVector *vector : vectors) {
+            for(int data : vector->data)
+                total += data;
+        }
+        return total;
+    }
+};
+
+// Structure to pass on the parameters of a run to the threads
+template<typename Composition>
+struct RunArguments {
+    Composition *composition;
+    int id;
+    long ops;
+    int vectors;
+    std::atomic<int> *ready;
+    std::atomic<bool> *go;
+};
+
+// Function run by every thread, which runs random composed operations
+template<typename Composition>
+void *worker(void *ptr) {
+    RunArguments<Composition> *args = (RunArguments<Composition> *)ptr;
+    unsigned seed = args->id + 1;
+    TM_THREAD_INIT();
+    args->ready->fetch_add(1);
+    while(!args->go->load())
+        ;
+    for(long i = 0; i < args->ops; i++) {
+        ComposedOperation op;
+        int kind = rand_r(&seed) % 10;
+        op.operation = kind < 4 ? TRANSFER : kind < 7 ? SWAP : kind < 9 ? UPDATE : PUSH_POP;
+        for(int k = 0; k < 3; k++) {
+            op.vector[k] = rand_r(&seed) % args->vectors;
+            op.random[k] = rand_r(&seed);
+        }
+        op.delta = rand_r(&seed) % 10;
+        args->composition->run(op);
+    }
+    TM_THREAD_SHUTDOWN();
+    return NULL;
+}
+
+// Function to get the throughput in millions of operations per second of a run with a given no. of threads
+// The sum of all elements must be the same after the run as before it, and no push-pop may mismatch, or the composition was not
+// atomic.
+template<typename Composition>
+double run(int threads, long ops, int vectors, int elements, bool &consistent) {
+    Composition *composition = new Composition(vectors, elements);
+    long long expected = composition->sum();
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<RunArguments<Composition>> args(threads);
+    std::vector<pthread_t> thread(threads);
+    for(int i = 0; i < threads; i++) {
+        args[i] = {composition, i, ops, vectors, &ready, &go};
+        pthread_create(&thread[i], NULL, worker<Composition>, &args[i]);
+    }
+    // The threads wait until all of them are running, so the timed region excludes thread creation
+    while(ready.load() < threads)
+        ;
+    auto t1 = benchmark_clock::now();
+    go = true;
+    for(int i = 0; i < threads; i++)
+        pthread_join(thread[i], NULL);
+    double seconds = std::chrono::duration<double>(benchmark_clock::now() - t1).count();
+    consistent = consistent && composition->sum() == expected && composition->mismatches == 0;
+    delete composition;
+    return threads * ops / seconds / 1e6;
+}
+
+// Function to check operations composed on the same vector, which must see what the transaction did to it so far
+/* The vectors start empty, so the third push of each transaction goes to a bucket that the transaction itself allocated, and that
+ * is only published when it commits.
+ */
+bool check_same_vector() {
+    TransactionalVector a, b;
+    int read_back, popped;
+    TransactionalVector::atomically([&] {
+        a.push_back(1);
+        a.push_back(2);
+        a.push_back(3);
+        read_back = a.read(2);
+        popped = a.pop_back();
+    });
+    TransactionalVector::atomically([&] {
+        b.push_back(5);
+        b.push_back(6);
+        b.push_back(7);
+        TransactionalVector::swap(b, 2, a, 0);
+        TransactionalVector::transfer(b, a);
+    });
+    return read_back == 3 && popped == 3 && a.get_size() == 3 && a.read(0) == 7 && a.read(1) == 2 && a.read(2) == 1 &&
+        b.get_size() == 2 && b.read(1) == 6;
+}
+
+// Main function
+int main(int argc, char **argv) {
+    int max_threads = 8;
+    long ops = 200000;
+    int vectors = 4;
+    int elements = 1024;
+    int c;
+    while((c = getopt(argc, argv, "t:n:v:m:")) != -1) {
+        switch(c) {
+        case 't': max_threads = atoi(optarg); break;
+        case 'n': ops = atol(optarg); break;
+        case 'v': vectors = std::max(1, atoi(optarg)); break;
+        case 'm': elements = atoi(optarg); break;
+        default:
+            std::cerr << "Usage: " << argv[0] << " [-t max threads] [-n ops per thread] [-v vectors] [-m initial elements per vector]"
+                << std::endl;
+            return 1;
+        }
+    }
+
+    TM_SYS_INIT();
+    TM_THREAD_INIT();
+    if(!check_same_vector()) {
+        std::cerr << "Operations composed on the same vector did not see each other" << std::endl;
+        return 1;
+    }
+    std::cout << ops << " ops per thread on " << vectors << " vectors of " << elements << " elements, " << TM_BACKEND_NAME
+        << " transactions" << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(14) << "global lock" << std::setw(14) << "vector locks" << std::setw(14)
+        << "transactions" << "  (Mops/s)" << std::endl;
+    bool consistent = true;
+    for(int threads = 1; threads <= max_threads; threads *= 2) {
+        double global = run<LockComposition<true>>(threads, ops, vectors, elements, consistent);
+        double striped = run<LockComposition<false>>(threads, ops, vectors, elements, consistent);
+        double transactional = run<TransactionalComposition>(threads, ops, vectors, elements, consistent);
+        std::cout << std::setw(8) << threads << std::fixed << std::setprecision(2) << std::setw(14) << global << std::setw(14) << striped
+            << std::setw(14) << transactional << std::endl;
+    }
+    TM_THREAD_SHUTDOWN();
+    TM_SYS_SHUTDOWN();
+    if(!consistent) {
+        std::cerr << "The sum of the elements changed, or a push-pop mismatched, during a run" << std::endl;
+        return 1;
+    }
+    return 0;
+}
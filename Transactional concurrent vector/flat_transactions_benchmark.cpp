@@ -0,0 +1,198 @@
+/*
+ * Benchmark of push_back()/pop_back() of the transactional vector, against the nested transactions they used to run, for a growing
+ * no. of threads.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <cstdlib>
+#include <pthread.h>
+#include <getopt.h>
+#include "tm.hpp"
+#include "transactional_vector.hpp"
+
+typedef std::chrono::steady_clock benchmark_clock;
+
+// push_back()/pop_back() as they were before the transactions were flattened
+/* highest_bit() ran a transaction of its own, three times per push, the first bucket size was read transactionally, every operation
+ * initialized and shut down the thread, and the benchmark wrapped every operation in a further transaction. Kept to measure what
+ * that instrumentation costs. The buckets come from malloc() rather than new[], which GCC's atomic transactions do not allow.
+ */
+class NestedVector {
+    static const int BUCKETS = 62;
+    int first_bucket_size;
+    int **memory = new int*[BUCKETS]();
+    long long size;
+
+public:
+    NestedVector() {
+        size = 0;
+        first_bucket_size = 2;
+        memory[0] = (int *)malloc(first_bucket_size * sizeof(int));
+    }
+
+    ~NestedVector() {
+        for(int i = 0; i < BUCKETS; i++)
+            free(memory[i]);
+        delete[] memory;
+    }
+
+    int highest_bit(long long num) {
+        int result;
+        TM_THREAD_INIT();
+        TM_BEGIN(atomic) {
+            if(!num)
+                result = 0;
+            else
+                result = 63 - __builtin_clzll(num);
+        } TM_END;
+        TM_THREAD_SHUTDOWN();
+        return result;
+    }
+
+    TM_NOINLINE void push_back(int data) {
+        TM_THREAD_INIT();
+        TM_BEGIN(atomic) {
+            TM_BEGIN(atomic) {
+                long long local_size = TM_READ(size);
+                int local_first_bucket_size = TM_READ(first_bucket_size);
+                int bucket = highest_bit(local_size + local_first_bucket_size) - highest_bit(local_first_bucket_size);
+                if(TM_READ(memory[bucket]) == NULL) {
+                    long long new_bucket_size = (long long)local_first_bucket_size << bucket;
+                    memory[bucket] = (int *)malloc(new_bucket_size * sizeof(int));
+                }
+                long long pos = local_size + local_first_bucket_size;
+                int hibit = highest_bit(pos);
+                long long index = pos ^ (1LL << hibit);
+                TM_WRITE(memory[hibit - highest_bit(local_first_bucket_size)][index], data);
+                TM_WRITE(size, local_size+1);
+            } TM_END;
+        } TM_END;
+        TM_THREAD_SHUTDOWN();
+    }
+
+    TM_NOINLINE int pop_back() {
+        TM_THREAD_INIT();
+        int data;
+        TM_BEGIN(atomic) {
+            TM_BEGIN(atomic) {
+                long long local_size = TM_READ(size);
+                if(local_size == 0)
+                    data = -1;
+                else {
+                    long long pos = local_size-1 + first_bucket_size;
+                    int hibit = highest_bit(pos);
+                    long long index = pos ^ (1LL << hibit);
+                    data = TM_READ(memory[hibit - highest_bit(first_bucket_size)][index]);
+                    TM_WRITE(size, local_size-1);
+                }
+            } TM_END;
+        } TM_END;
+        TM_THREAD_SHUTDOWN();
+        return data;
+    }
+};
+
+// Structure to pass on the parameters of a run to the threads
+template<typename Container>
+struct RunArguments {
+    Container *vector;
+    long ops;
+    std::atomic<int> *ready;
+    std::atomic<bool> *go;
+};
+
+// Function run by every thread, which pushes and pops in turn
+template<typename Container>
+void *worker(void *ptr) {
+    RunArguments<Container> *args = (RunArguments<Container> *)ptr;
+    TM_THREAD_INIT();
+    args->ready->fetch_add(1);
+    while(!args->go->load())
+        ;
+    for(long i = 0; i < args->ops; i += 2) {
+        args->vector->push_back(i);
+        args->vector->pop_back();
+    }
+    TM_THREAD_SHUTDOWN();
+    return NULL;
+}
+
+// Function to get the throughput in millions of operations per second of a run with a given no. of threads
+template<typename Container>
+double run(int threads, long ops) {
+    Container *vector = new Container();
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    RunArguments<Container> args = {vector, ops, &ready, &go};
+    std::vector<pthread_t> thread(threads);
+    for(int i = 0; i < threads; i++)
+        pthread_create(&thread[i], NULL, worker<Container>, &args);
+    // The threads wait until all of them are running, so the timed region excludes thread creation
+    while(ready.load() < threads)
+        ;
+    auto t1 = benchmark_clock::now();
+    go = true;
+    for(int i = 0; i < threads; i++)
+        pthread_join(thread[i], NULL);
+    double seconds = std::chrono::duration<double>(benchmark_clock::now() - t1).count();
+    delete vector;
+    return threads * ops / seconds / 1e6;
+}
+
+// Function to check that operations nested in one transaction see the buckets its earlier pushes allocated
+/* The third push goes to the second bucket, which the first push allocated, and the pointer to it is only in the transaction's log
+ * until the transaction commits.
+ */
+bool check_nested_growth() {
+    TransactionalVector *vector = new TransactionalVector();
+    int data;
+    TM_BEGIN(atomic) {
+        vector->push_back(1);
+        vector->push_back(2);
+        vector->push_back(3);
+        vector->write(2, 4);
+        data = vector->read(2) * 10 + vector->pop_back();
+    } TM_END;
+    bool correct = data == 44 && vector->get_size() == 2 && vector->read(1) == 2;
+    delete vector;
+    return correct;
+}
+
+// Main function
+int main(int argc, char **argv) {
+    int max_threads = 8;
+    long ops = 1000000;
+    int c;
+    while((c = getopt(argc, argv, "t:n:")) != -1) {
+        switch(c) {
+        case 't': max_threads = atoi(optarg); break;
+        case 'n': ops = atol(optarg); break;
+        default:
+            std::cerr << "Usage: " << argv[0] << " [-t max threads] [-n ops per thread]" << std::endl;
+            return 1;
+        }
+    }
+
+    TM_SYS_INIT();
+    TM_THREAD_INIT();
+    if(!check_nested_growth()) {
+        std::cerr << "Operations nested in a transaction did not see the buckets it allocated" << std::endl;
+        return 1;
+    }
+    std::cout << ops << " ops per thread, " << TM_BACKEND_NAME << " transactions" << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(16) << "nested Mops/s" << std::setw(16) << "flat Mops/s" << std::setw(10)
+        << "speedup" << std::endl;
+    for(int threads = 1; threads <= max_threads; threads *= 2) {
+        double nested = run<NestedVector>(threads, ops);
+        double flat = run<TransactionalVector>(threads, ops);
+        std::cout << std::setw(8) << threads << std::fixed << std::setprecision(2) << std::setw(16) << nested << std::setw(16) << flat
+            << std::setw(10) << flat / nested << std::endl;
+    }
+    TM_THREAD_SHUTDOWN();
+    TM_SYS_SHUTDOWN();
+    return 0;
+}
@@ -2,24 +2,21 @@
 #include <iostream>
 #include <signal.h>
 #include <pthread.h>
-#include <api/api.hpp>
-#include <common/platform.hpp>
-#include <common/locks.hpp>
-#include "bmconfig.hpp"
-#include "../include/api/api.hpp"
+#include "tm.hpp"
+#include "bench_config.hpp"
+#include "transactional_vector.hpp"
 #include <vector>
 #include <iostream>
 #include <atomic>
 #include <pthread.h>
-#include <cmath>
 #include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <getopt.h>
+#include <unistd.h>
 using namespace std;
 
 const int THREAD_COUNT = 8;
-const int NUM_TRANSACTIONS = 500000;
-const int SPLIT_RATIO = 0.5;
-// shared variable that will be incremented by transactions
-int x = 0;
 
 Config::Config() :
     bmname(""),
@@ -28,8 +25,8 @@ Config::Config() :
     threads(THREAD_COUNT),
     nops_after_tx(0),
     elements(256),
-    lookpct(34),
-    inspct(66),
+    lookpct(60),
+    inspct(10),
     sets(1),
     ops(1),
     time(0),
@@ -42,195 +39,288 @@ Config CFG TM_ALIGN(64);
 
 /*************************************************************************************/
 
-class Vector {
-    // Variable to specify the initial array size
-    int first_bucket_size;
-    // 2-level array to store the data
-    int **memory = new int*[32];
-    // Variable to track the size of the vector
-    int size;
-public:
-    // Public constructor
-    Vector() {
-        size = 0;
-        first_bucket_size = 2;
-        memory[0] = new int[first_bucket_size];
-    }
+// The benchmark below refers to the transactional vector as Vector
+typedef TransactionalVector Vector;
 
-    // Function to get the highest set bit in a given integer
-    int highest_bit(int num) {
-        int result;
-        TM_THREAD_INIT();
-        TM_BEGIN(atomic) {
-            // __builtin_clz() gives the count of leading zeros, which is used to indirectly get the number of the highest set bit
-            // It'll not work with 0. Hence, 0 must be checked separately.
-            if(!num) 
-                result = 0;
-            else
-                result = 31 - __builtin_clz(num);
-        } TM_END;
-        TM_THREAD_SHUTDOWN();
-        return result;
-    }
+/*************************************************************************************/
 
-    // Function to push an element to the tail of the vector
-    // The biggest difference with the lock-free version is the lack of a descriptor object
-    void push_back(int data) {
-        TM_THREAD_INIT();
-        TM_BEGIN(atomic) {
-            int local_size = TM_READ(size);
-            int local_first_bucket_size = TM_READ(first_bucket_size);
-            int bucket = highest_bit(local_size + local_first_bucket_size) - highest_bit(local_first_bucket_size);
-            if(TM_READ(memory[bucket]) == NULL) {
-                int new_bucket_size = std::pow(local_first_bucket_size,bucket+1);
-                memory[bucket] = new int[new_bucket_size];
-            }
-            int pos = local_size + local_first_bucket_size;
-            int hibit = highest_bit(pos);
-            int index = pos ^ (int)std::pow(2, hibit);
-            TM_WRITE(memory[hibit - highest_bit(local_first_bucket_size)][index], data);
-            TM_WRITE(size, local_size+1);
-        } TM_END;
-        TM_THREAD_SHUTDOWN();
-    }
+// Structure to pass on multiple parameters to the threaded function
+struct MyArguments {
+    int id;
+    // Transactions and operations the thread ran
+    long long transactions;
+    long long operations;
+    // Elements the thread's committed transactions pushed, less those they popped, to check the final size against
+    long long size_change;
+    // Transaction statistics of the thread, filled in when it is done
+    TMStats stats;
+};
 
-    // Function to remove an element from the tail of the vector
-    int pop_back() {
-        TM_THREAD_INIT();
-        int data;
-        TM_BEGIN(atomic) {
-            int local_size = TM_READ(size);
-            if(local_size == 0) return -1;
-            int pos = local_size-1 + first_bucket_size;
-            int hibit = highest_bit(pos);
-            int index = pos ^ (int)std::pow(2, hibit);
-            data = TM_READ(memory[hibit - highest_bit(first_bucket_size)][index]);
-            TM_WRITE(size, local_size-1);
-        } TM_END;
-        TM_THREAD_SHUTDOWN();
-        return data;
+// Operations of the workload
+/* Config only knows lookups and inserts, which are the reads and pushes. The writes and size queries have percentages of their own,
+ * and the pops take whatever is left, so with as many pushes as pops the vector keeps about its initial size.
+ */
+enum Operation {OP_READ, OP_WRITE, OP_PUSH, OP_POP, OP_SIZE};
+
+uint32_t writepct = 10;
+uint32_t sizepct = 10;
+
+// Structure to hold an operation of a transaction, drawn before the transaction starts
+/* A transaction that aborts runs again from TM_BEGIN, so the operations must not be drawn inside it. The random number picks the
+ * position of a read or a write, and the result is kept in memory, as locals changed in a transaction are lost when it restarts.
+ */
+struct TxOperation {
+    Operation operation;
+    unsigned random;
+    long long result;
+};
+
+// Names of the contention management policies, in the order of TMContention
+const char *CONTENTION_NAMES[] = {"backoff", "aggressive", "polite"};
+
+// Function to print the transaction statistics of every thread and their total
+void print_stats(MyArguments *args, int thread_count) {
+    if(!TM_HAS_STATS) {
+        std::cout << "transaction statistics are not available with the " << TM_BACKEND_NAME << " backend" << std::endl;
+        return;
+    }
+    std::cout << std::setw(8) << "thread" << std::setw(12) << "commits" << std::setw(12) << "aborts" << std::setw(12) << "validation"
+        << std::setw(12) << "conflict" << std::setw(12) << "explicit" << std::setw(10) << "serial" << std::setw(12) << "retries/tx"
+        << std::setw(12) << "max retries" << std::endl;
+    TMStats total = TMStats();
+    for(int i = 0; i <= thread_count; i++) {
+        // The last row is the total over all threads
+        TMStats &stats = i < thread_count ? args[i].stats : total;
+        if(i < thread_count) {
+            total.commits += stats.commits;
+            total.aborts += stats.aborts;
+            total.validation_aborts += stats.validation_aborts;
+            total.conflict_aborts += stats.conflict_aborts;
+            total.explicit_aborts += stats.explicit_aborts;
+            total.serial_commits += stats.serial_commits;
+            total.max_retries = std::max(total.max_retries, stats.max_retries);
+            std::cout << std::setw(8) << i;
+        }
+        else
+            std::cout << std::setw(8) << "total";
+        std::cout << std::setw(12) << stats.commits << std::setw(12) << stats.aborts << std::setw(12) << stats.validation_aborts
+            << std::setw(12) << stats.conflict_aborts << std::setw(12) << stats.explicit_aborts << std::setw(10) << stats.serial_commits
+            << std::setw(12) << std::fixed << std::setprecision(3) << (stats.commits ? (double)stats.aborts / stats.commits : 0)
+            << std::setw(12) << stats.max_retries << std::endl;
     }
+}
 
-    // Function to write a given element to a given position
-    void write(int i, int data) {
-        TM_THREAD_INIT();
-        TM_BEGIN(atomic) {
-            int local_first_bucket_size = TM_READ(first_bucket_size);
-            int pos = i + first_bucket_size;
-            int hibit = highest_bit(pos);
-            int index = pos ^ (int)std::pow(2, hibit);
-            TM_WRITE(memory[hibit - highest_bit(local_first_bucket_size)][index], data);
-        } TM_END;
-        TM_THREAD_SHUTDOWN();
+// Global Vector object
+Vector v;
+
+// Function to get the operation a random percentage falls into
+Operation pick_operation(uint32_t percent) {
+    if(percent < CFG.lookpct)
+        return OP_READ;
+    percent -= CFG.lookpct;
+    if(percent < writepct)
+        return OP_WRITE;
+    percent -= writepct;
+    if(percent < CFG.inspct)
+        return OP_PUSH;
+    percent -= CFG.inspct;
+    if(percent < sizepct)
+        return OP_SIZE;
+    return OP_POP;
+}
+
+// Function to run the operations of a transaction, inside the caller's transaction
+static void run_operations(TxOperation *ops, uint32_t count, int data) {
+    for(uint32_t i = 0; i < count; i++) {
+        TxOperation &op = ops[i];
+        switch(op.operation) {
+        case OP_READ: {
+            // Reads and writes pick a position below the size the transaction sees, so they never reach a missing bucket
+            long long size = v.get_size();
+            op.result = size ? v.read(op.random % size) : -1;
+            break;
+        }
+        case OP_WRITE: {
+            long long size = v.get_size();
+            if(size)
+                v.write(op.random % size, data);
+            break;
+        }
+        case OP_PUSH:
+            v.push_back(data);
+            break;
+        case OP_POP:
+            op.result = v.pop_back();
+            break;
+        case OP_SIZE:
+            op.result = v.get_size();
+            break;
+        }
     }
+}
 
-    // Function to read an element at a given position
-    int read(int i) {
-        int data;
-        TM_THREAD_INIT();
-        TM_BEGIN(atomic) {
-            int pos = i + first_bucket_size;
-            int hibit = highest_bit(pos);
-            int index = pos ^ (int)std::pow(2, hibit);
-            data = TM_READ(memory[hibit - highest_bit(first_bucket_size)][index]);
+// Function to run the operations of a transaction as one transaction, read-only if they only read
+static TM_NOINLINE void run_transaction(TxOperation *ops, uint32_t count, int data, bool readonly) {
+    if(readonly) {
+        TM_BEGIN_READONLY() {
+            run_operations(ops, count, data);
         } TM_END;
-        TM_THREAD_SHUTDOWN();
-        return data;
     }
-
-    // Function to get the current size of the vector
-    int get_size() {
-        int local_size;
-        TM_THREAD_INIT();
+    else {
         TM_BEGIN(atomic) {
-            local_size = TM_READ(size);
+            run_operations(ops, count, data);
         } TM_END;
-        TM_THREAD_SHUTDOWN();
-        return local_size;
-    }
-
-    // Function to display the contents of the vector
-    void display() {
-        for(int i = 0; i < size; i++) {
-            int pos = i + first_bucket_size;
-            int hibit = highest_bit(pos);
-            int index = pos ^ (int)std::pow(2, hibit);
-            std::cout << memory[hibit - highest_bit(first_bucket_size)][index] << " ";
-        }
-        std::cout << std::endl;
     }
-};
-
-/*************************************************************************************/
-
-// Structure to pass on multiple parameters to the threaded function
-struct MyArguments {
-    int data;
-    int operation;
-};
+}
 
-// Global Vector object
-Vector v;
+// Function to stop the threads once the duration of the run is over
+void catch_SIGALRM(int) {
+    __atomic_store_n(&CFG.running, false, __ATOMIC_RELAXED);
+}
 
 void* run_thread(void* i) {
     // each thread must be initialized before running transactions
     TM_THREAD_INIT();
     // Read the arguments passed to each thread
     struct MyArguments *args = (MyArguments *)i;
-    int data = args->data;
-    int operation = args->operation;
-    for(int i=0; i<NUM_TRANSACTIONS; i++) {
-        // mark the beginning of a transaction
-        TM_BEGIN(atomic)
-        {
-            // Some threads are tasked with pushing to the vector while others are tasked with popping
-            if(operation == 0)
-                v.push_back(data);
-            else
-                v.pop_back();
+    unsigned seed = args->id + 1;
+    TxOperation *ops = new TxOperation[CFG.ops];
+    long long transactions = 0;
+    long long size_change = 0;
+    // The run lasts CFG.duration seconds, unless every thread is to run a fixed no. of transactions
+    while(CFG.execute ? transactions < CFG.execute : __atomic_load_n(&CFG.running, __ATOMIC_RELAXED)) {
+        bool readonly = true;
+        for(uint32_t j = 0; j < CFG.ops; j++) {
+            ops[j].operation = pick_operation(rand_r(&seed) % 100);
+            ops[j].random = rand_r(&seed);
+            readonly = readonly && (ops[j].operation == OP_READ || ops[j].operation == OP_SIZE);
+        }
+        // The operations of a transaction nest in it, so they take effect together. A transaction of reads and size queries only
+        // runs as a read-only one.
+        run_transaction(ops, CFG.ops, args->id, readonly);
+        transactions++;
+        // The elements are thread ids and prefill positions, so only a pop that found the vector empty returned -1
+        for(uint32_t j = 0; j < CFG.ops; j++) {
+            if(ops[j].operation == OP_PUSH)
+                size_change++;
+            else if(ops[j].operation == OP_POP && ops[j].result != -1)
+                size_change--;
         }
-        TM_END; // mark the end of the transaction
+        // Think time between the transactions
+        for(uint32_t j = 0; j < CFG.nops_after_tx; j++)
+            __asm__ volatile("nop");
     }
+    args->transactions = transactions;
+    args->operations = transactions * CFG.ops;
+    args->size_change = size_change;
+    delete[] ops;
 
+    TM_STATS(args->stats);
     TM_THREAD_SHUTDOWN();
+    return NULL;
 }
 
 int main(int argc, char** argv) {
 
-    // Define the arguments for the run() method
-    int thread_count = THREAD_COUNT;
-    float split_ratio = SPLIT_RATIO; // Used to split the threads into pushers and poppers
-    int split_count = thread_count * split_ratio;
+    // Contention management policy, and no. of aborts in a row after which a transaction runs serially, 0 for never
+    int contention = TM_BACKOFF;
+    int serial_limit = 0;
+    int c;
+    while((c = getopt(argc, argv, "t:d:x:m:r:w:p:z:o:n:c:s:")) != -1) {
+        switch(c) {
+        case 't':
+            CFG.threads = std::max(1, std::min(atoi(optarg), 256));
+            break;
+        case 'd':
+            // alarm(0) sets no alarm, so a timed run must last at least a second
+            if(atoi(optarg) < 1) {
+                std::cerr << "The duration must be at least 1 second" << std::endl;
+                return 1;
+            }
+            CFG.duration = atoi(optarg);
+            break;
+        case 'x':
+            CFG.execute = atoi(optarg);
+            break;
+        case 'm':
+            CFG.elements = atoi(optarg);
+            break;
+        case 'r':
+            CFG.lookpct = atoi(optarg);
+            break;
+        case 'w':
+            writepct = atoi(optarg);
+            break;
+        case 'p':
+            CFG.inspct = atoi(optarg);
+            break;
+        case 'z':
+            sizepct = atoi(optarg);
+            break;
+        case 'o':
+            CFG.ops = std::max(1, atoi(optarg));
+            break;
+        case 'n':
+            CFG.nops_after_tx = atoi(optarg);
+            break;
+        case 'c':
+            contention = 0;
+            while(contention < 3 && strcmp(optarg, CONTENTION_NAMES[contention]) != 0)
+                contention++;
+            if(contention == 3) {
+                std::cerr << "Unknown contention policy " << optarg << std::endl;
+                return 1;
+            }
+            break;
+        case 's':
+            serial_limit = atoi(optarg);
+            break;
+        default:
+            std::cerr << "Usage: " << argv[0] << " [-t threads] [-d seconds] [-x transactions per thread] [-m initial elements]"
+                " [-r read %] [-w write %] [-p push %] [-z size %] [-o ops per transaction] [-n nops after a transaction]"
+                " [-c backoff|aggressive|polite] [-s serial after N aborts]" << std::endl;
+            return 1;
+        }
+    }
+    if(CFG.lookpct + writepct + CFG.inspct + sizepct > 100) {
+        std::cerr << "The read, write, push and size percentages add up to more than 100" << std::endl;
+        return 1;
+    }
 
-    struct MyArguments args1[thread_count+1];
+    // Define the arguments for the run() method
+    int thread_count = CFG.threads;
+    struct MyArguments args1[thread_count];
 
     TM_SYS_INIT();
+    TM_CONTENTION((TMContention)contention, serial_limit);
 
     // original thread must be initalized also
     TM_THREAD_INIT();
 
-    void* args[256];
+    // Fill the vector up to its initial size before the run
+    for(uint32_t i = 0; i < CFG.elements; i++)
+        v.push_back(i);
+
     pthread_t tid[256];
 
     // set up configuration structs for the threads we'll create
     pthread_attr_t attr;
     pthread_attr_init(&attr);
     pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM);
-    for (uint32_t i = 0; i < CFG.threads; i++)
-        args[i] = (void*)i;
+    for (int i = 0; i < thread_count; i++)
+        args1[i].id = i;
+
+    // A timed run ends when the alarm goes off
+    if(!CFG.execute) {
+        signal(SIGALRM, catch_SIGALRM);
+        alarm(CFG.duration);
+    }
 
     // Start timing the execution runtime
     auto t1 = std::chrono::steady_clock::now();
     // actually create the threads
-    for (uint32_t j = 1; j < CFG.threads; j++) {
-        args1[j].data = j;
-        if((int)j < split_count)
-            args1[j].operation = 0;
-        else
-            args1[j].operation = 1;
+    for (int j = 1; j < thread_count; j++)
         pthread_create(&tid[j],&attr,run_thread,(void *)&args1[j]);
-    }
-    
 
     // all of the other threads should be queued up, waiting to run the
     // benchmark, but they can't until this thread starts the benchmark
@@ -239,7 +329,7 @@ int main(int argc, char** argv) {
 
     // everyone should be done.  Join all threads so we don't leave anything
     // hanging around
-    for (uint32_t k = 1; k < CFG.threads; k++)
+    for (int k = 1; k < thread_count; k++)
         pthread_join(tid[k], NULL);
     auto t2 = std::chrono::steady_clock::now();
 
@@ -247,10 +337,32 @@ int main(int argc, char** argv) {
     TM_SYS_SHUTDOWN();
 
     // Print the final metrics
-    printf("x = %d\n", x); // x should equal (THREAD_COUNT * NUM_TRANSACTIONS)
-    std::cout << "vector size = " << v.get_size() << std::endl;
-    auto elapsed = std::chrono::duration_cast< std::chrono::milliseconds>(t2 - t1); 
-    std::cout << "time elapsed = " << elapsed.count() << std::endl;
+    long long operations = 0;
+    long long expected_size = CFG.elements;
+    CFG.txcount = 0;
+    for (int i = 0; i < thread_count; i++) {
+        CFG.txcount += args1[i].transactions;
+        operations += args1[i].operations;
+        expected_size += args1[i].size_change;
+    }
+    auto elapsed = std::chrono::duration_cast< std::chrono::milliseconds>(t2 - t1);
+    CFG.time = elapsed.count();
+    double seconds = std::max(elapsed.count(), (long)1) / 1000.0;
+    std::cout << "threads = " << thread_count << ", " << CFG.ops << " ops per transaction, " << CFG.lookpct << "% read, " << writepct
+        << "% write, " << CFG.inspct << "% push, " << sizepct << "% size, "
+        << 100 - CFG.lookpct - writepct - CFG.inspct - sizepct << "% pop" << std::endl;
+    long long size = v.get_size();
+    std::cout << "vector size = " << size << " (initially " << CFG.elements << ", expected " << expected_size << ")" << std::endl;
+    std::cout << "time elapsed = " << CFG.time << std::endl;
+    std::cout << "transactions = " << CFG.txcount << ", operations = " << operations << std::endl;
+    std::cout << "ops/sec = " << std::fixed << std::setprecision(0) << operations / seconds << ", transactions/sec = "
+        << CFG.txcount / seconds << std::endl;
+    std::cout << "contention = " << CONTENTION_NAMES[contention] << ", serial after " << serial_limit << " aborts" << std::endl;
+    print_stats(args1, thread_count);
 
+    if(size != expected_size) {
+        std::cerr << "The size of the vector does not match the pushes and pops that committed" << std::endl;
+        return 1;
+    }
     return 0;
 }
@@ -0,0 +1,91 @@
+
+/*
+ * Transactional memory api of the transactional vector. Maps the TM_* macros of the RSTM api onto the backend chosen at compile time.
+ */
+
+#ifndef TM_HPP
+#define TM_HPP
+
+// Backends, chosen with -DTM_BACKEND_<name>:
+/* TL2    word-based STM with striped versioned locks and a global version clock, built in (tm_tl2.hpp)
+ * GNU    GCC's transactional memory, needs -fgnu-tm (tm_gnu.hpp)
+ * LOCK   every transaction holds a single global lock (tm_lock.hpp)
+ * RSTM   the RSTM library, when the file is built inside an RSTM tree
+ * Without a choice, RSTM is used if its api is on the include path, as when main.cpp is built in rstm/bench, and TL2 otherwise.
+ * Every backend provides TM_SYS_INIT/SHUTDOWN, TM_THREAD_INIT/SHUTDOWN, TM_BEGIN/TM_END, TM_READ/TM_WRITE, TM_ALLOC and TM_ALIGN,
+ * which are used as with RSTM:
+ *     TM_BEGIN(atomic) {
+ *         long long s = TM_READ(size);
+ *         TM_WRITE(size, s + 1);
+ *     } TM_END;
+ * A transaction that only reads can start with TM_BEGIN_READONLY() instead, which lets the STM skip the bookkeeping it would need
+ * to commit writes. TL2 keeps no read log for it, and the other backends run it as any other transaction.
+ * TM_ALLOC(bytes) allocates memory that is released with free(). Inside a transaction the allocation is undone if the transaction
+ * aborts, so memory it publishes never leaks. Transactions nest by flattening into the outermost one. A transaction must not be
+ * left with return, break or goto, since only the GNU and LOCK backends would commit it. TM_PURE marks a function that may be called
+ * in a transaction without being instrumented, such as one that peeks at shared memory with an atomic load. TM_NOINLINE marks a
+ * function that runs a transaction and is called in loops, which the GNU backend keeps out of its callers, as GCC treats the start
+ * of a transaction like setjmp() and warns about every local of the caller that the transaction could clobber.
+ * The backends that keep statistics define TM_HAS_STATS to 1, and TM_STATS(stats) then fills in those of the calling thread.
+ * TM_CONTENTION(policy, serial_limit) chooses how transactions handle conflicts. TL2 supports both, the other backends ignore
+ * TM_CONTENTION and report zeros, and TM_ABORT() to restart a transaction explicitly is only available with TL2.
+ */
+// Transaction statistics of a thread
+struct TMStats {
+    long commits;
+    long aborts;
+    // Aborts by reason: a word read that is newer than the start of the transaction, a word locked by a committing transaction,
+    // and TM_ABORT() or a read-only transaction that wrote
+    long validation_aborts;
+    long conflict_aborts;
+    long explicit_aborts;
+    // Transactions that committed serially after aborting too many times in a row
+    long serial_commits;
+    // Most aborts of a single transaction before it committed
+    long max_retries;
+};
+
+// Contention management policies
+enum TMContention {TM_BACKOFF, TM_AGGRESSIVE, TM_POLITE};
+
+#if !defined(TM_BACKEND_TL2) && !defined(TM_BACKEND_GNU) && !defined(TM_BACKEND_LOCK) && !defined(TM_BACKEND_RSTM)
+#if defined(__has_include)
+#if __has_include(<api/api.hpp>)
+#define TM_BACKEND_RSTM
+#endif
+#endif
+#endif
+
+#if defined(TM_BACKEND_RSTM)
+#include <api/api.hpp>
+#define TM_BACKEND_NAME "rstm"
+#elif defined(TM_BACKEND_GNU)
+#include "tm_gnu.hpp"
+#elif defined(TM_BACKEND_LOCK)
+#include "tm_lock.hpp"
+#else
+#ifndef TM_BACKEND_TL2
+#define TM_BACKEND_TL2
+#endif
+#include "tm_tl2.hpp"
+#endif
+
+#ifndef TM_BEGIN_READONLY
+#define TM_BEGIN_READONLY() TM_BEGIN(atomic)
+#endif
+
+#ifndef TM_PURE
+#define TM_PURE
+#endif
+
+#ifndef TM_NOINLINE
+#define TM_NOINLINE
+#endif
+
+#ifndef TM_HAS_STATS
+#define TM_HAS_STATS 0
+#define TM_STATS(out) ((out) = TMStats())
+#define TM_CONTENTION(contention, limit)
+#endif
+
+#endif
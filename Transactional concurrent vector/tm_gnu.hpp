@@ -0,0 +1,34 @@
+
+/*
+ * GCC transactional memory backend of the transactional memory api. Needs -fgnu-tm, which links in libitm.
+ */
+
+#ifndef TM_GNU_HPP
+#define TM_GNU_HPP
+
+#include <cstdlib>
+
+#ifndef __GNUC__
+#error "The GNU backend needs GCC's transactional memory"
+#endif
+
+// Transactions are atomic ones, so the compiler rejects any call in them that is not transaction safe, such as new[]. Memory is
+// allocated with TM_ALLOC instead. The compiler instruments every access, so TM_READ and TM_WRITE are plain accesses.
+#define TM_BACKEND_NAME "gnu"
+#define TM_SYS_INIT()
+#define TM_SYS_SHUTDOWN()
+#define TM_THREAD_INIT()
+#define TM_THREAD_SHUTDOWN()
+#define TM_ALIGN(N) __attribute__((aligned(N)))
+#define TM_BEGIN(type) __transaction_atomic {
+#define TM_END }
+#define TM_READ(var) (var)
+#define TM_WRITE(var, val) ((var) = (val))
+// Functions that only read shared memory racily, outside of the STM, are left uninstrumented and allowed in transactions
+#define TM_PURE __attribute__((transaction_pure))
+// A transaction starts like setjmp(), so a function that one is inlined into would have all its locals at risk of being clobbered
+#define TM_NOINLINE __attribute__((noinline))
+// libitm logs allocations made inside a transaction and frees them if it aborts
+#define TM_ALLOC(size) malloc(size)
+
+#endif
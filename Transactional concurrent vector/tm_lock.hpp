@@ -0,0 +1,36 @@
+
+/*
+ * Single global lock backend of the transactional memory api.
+ */
+
+#ifndef TM_LOCK_HPP
+#define TM_LOCK_HPP
+
+#include <mutex>
+#include <cstdlib>
+
+// Every transaction holds the same lock from TM_BEGIN to TM_END, so transactions never abort and never run concurrently
+/* The lock is recursive so that nested transactions flatten into the outermost one, and it is released by a guard, so a transaction
+ * left early still gives it up. It is the baseline the STM backends have to beat.
+ */
+class GlobalLockTM {
+public:
+    static std::recursive_mutex &lock() {
+        static std::recursive_mutex global_lock;
+        return global_lock;
+    }
+};
+
+#define TM_BACKEND_NAME "lock"
+#define TM_SYS_INIT()
+#define TM_SYS_SHUTDOWN()
+#define TM_THREAD_INIT()
+#define TM_THREAD_SHUTDOWN()
+#define TM_ALIGN(N) __attribute__((aligned(N)))
+#define TM_BEGIN(type) { std::lock_guard<std::recursive_mutex> tm_guard(GlobalLockTM::lock()); {
+#define TM_END } }
+#define TM_READ(var) (var)
+#define TM_WRITE(var, val) ((var) = (val))
+#define TM_ALLOC(size) malloc(size)
+
+#endif
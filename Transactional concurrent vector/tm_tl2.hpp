@@ -0,0 +1,451 @@
+
+/*
+ * Built-in word-based STM backend of the transactional memory api, after TL2 (Dice, Shalev and Shavit, Transactional Locking II).
+ */
+
+#ifndef TM_TL2_HPP
+#define TM_TL2_HPP
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <csetjmp>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <algorithm>
+
+// TL2 software transactional memory
+/* Memory is covered by a table of versioned locks, each word mapping to one of them by its address. A lock holds the version of the
+ * last commit that wrote a word it covers, shifted left by one, with the low bit set while a committing transaction holds it.
+ * A transaction samples the global version clock when it starts. Every read checks that the lock of the word is free and no newer
+ * than that sample, both before and after loading the word, so a transaction only ever sees a consistent snapshot and needs no
+ * validation of its own until it commits. Writes are buffered in a redo log, and reads of a word the transaction wrote are served
+ * from it.
+ * A committing transaction locks the words it wrote, takes a new version from the clock, checks that nothing it read has changed
+ * since it started, writes the log back and releases the locks with the new version. A read-only transaction has nothing to do at
+ * commit, and one started with TM_BEGIN_READONLY() does not even log its reads. If it writes after all, it restarts as an update
+ * transaction. A word newer than the sample normally aborts the transaction, but one that has not read anything yet takes a new
+ * sample instead, as there is nothing it saw that could be inconsistent with it. A transaction that finds a conflict aborts: it drops its logs, backs off for a random time and longjmp()s back to its
+ * TM_BEGIN, which is why the code of a transaction must not rely on destructors or on locals it changed before the abort. Memory
+ * allocated with TM_ALLOC is freed again by an abort, so only a committed transaction can publish it.
+ * What a transaction does about a conflict is up to the contention policy, which applies to all threads:
+ * TM_BACKOFF      abort at once and back off for a random time that doubles with every abort of the transaction
+ * TM_AGGRESSIVE   abort at once and restart at once
+ * TM_POLITE       on finding a word locked by a committing transaction, wait for the lock a few times, doubling the wait each
+ *                 time, and only abort if it is still held. Restart at once.
+ * With a serial limit of N, a transaction that has aborted N times in a row runs serially: it waits for the running transactions
+ * to finish and keeps new ones from starting until it commits, so it cannot fail again. Running transactions are tracked with a
+ * flag per thread, which costs a fence per transaction and is only done while the limit is set.
+ * Every location must always be accessed with the same type, of at most 8 bytes.
+ */
+class TL2 {
+    static constexpr int LOCKS = 1 << 20;
+    static constexpr int MAX_BACKOFF = 1 << 16;
+    static constexpr int POLITE_ROUNDS = 8;
+
+    enum Reason {VALIDATION, CONFLICT, EXPLICIT};
+
+    struct WriteEntry {
+        void *address;
+        uint64_t value;
+        int size;
+    };
+
+    struct LockEntry {
+        std::atomic<uint64_t> *lock;
+        // Version of the lock before the transaction took it
+        uint64_t version;
+    };
+
+    // Per-thread transaction descriptor
+    struct Transaction {
+        int depth = 0;
+        jmp_buf *checkpoint = NULL;
+        uint64_t read_version = 0;
+        // Set for a read-only transaction, which keeps no read log
+        bool readonly = false;
+        // Set when a read-only transaction wrote, so that it runs as an update transaction until it commits
+        bool upgraded = false;
+        // Set once the transaction has read a word from memory, after which its snapshot is fixed
+        bool has_read = false;
+        std::vector<std::atomic<uint64_t> *> reads;
+        std::vector<WriteEntry> writes;
+        // One bit per address hash of the words in the redo log, so reads of words the transaction did not write skip the search
+        uint64_t write_filter = 0;
+        std::vector<LockEntry> locked;
+        // Memory allocated by the transaction, which it frees if it aborts
+        std::vector<void *> allocations;
+        int backoff = 0;
+        unsigned int seed = 0;
+        // Set while the thread runs a transaction, if a serial limit is set, so that a serial transaction can wait for it
+        std::atomic<bool> active{false};
+        bool serial = false;
+        // Aborts of the current transaction so far
+        int retries = 0;
+        TMStats stats = TMStats();
+
+        Transaction() {
+            std::lock_guard<std::mutex> guard(registry_lock());
+            registry().push_back(this);
+        }
+
+        ~Transaction() {
+            std::lock_guard<std::mutex> guard(registry_lock());
+            registry().erase(std::find(registry().begin(), registry().end(), this));
+        }
+    };
+
+    // Transactions of all the threads, for a serial transaction to wait on
+    static std::vector<Transaction *> &registry() {
+        static std::vector<Transaction *> transactions;
+        return transactions;
+    }
+
+    static std::mutex &registry_lock() {
+        static std::mutex lock;
+        return lock;
+    }
+
+    // Set while a serial transaction runs
+    static std::atomic<bool> &serial_flag() {
+        static std::atomic<bool> flag(false);
+        return flag;
+    }
+
+    static std::atomic<int> &policy() {
+        static std::atomic<int> contention(TM_BACKOFF);
+        return contention;
+    }
+
+    // No. of aborts in a row after which a transaction runs serially, 0 if it never does
+    static std::atomic<int> &serial_limit() {
+        static std::atomic<int> limit(0);
+        return limit;
+    }
+
+    static std::atomic<uint64_t> &global_clock() {
+        static std::atomic<uint64_t> clock(0);
+        return clock;
+    }
+
+    static std::atomic<uint64_t> &lock_of(const void *address) {
+        static std::atomic<uint64_t> locks[LOCKS];
+        return locks[((uintptr_t)address >> 3) & (LOCKS - 1)];
+    }
+
+    static uint64_t filter_bit(const void *address) {
+        return 1ULL << (((uintptr_t)address >> 2) & 63);
+    }
+
+    static Transaction &self() {
+        static thread_local Transaction tx;
+        return tx;
+    }
+
+    // Function to check if a lock is held by the calling transaction, and if so get its version from before it was taken
+    static bool held(Transaction &tx, std::atomic<uint64_t> *lock, uint64_t &version) {
+        for(const LockEntry &entry : tx.locked) {
+            if(entry.lock == lock) {
+                version = entry.version;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static void store_word(const WriteEntry &entry) {
+        switch(entry.size) {
+        case 1: __atomic_store_n((uint8_t *)entry.address, (uint8_t)entry.value, __ATOMIC_RELAXED); break;
+        case 2: __atomic_store_n((uint16_t *)entry.address, (uint16_t)entry.value, __ATOMIC_RELAXED); break;
+        case 4: __atomic_store_n((uint32_t *)entry.address, (uint32_t)entry.value, __ATOMIC_RELAXED); break;
+        default: __atomic_store_n((uint64_t *)entry.address, entry.value, __ATOMIC_RELAXED); break;
+        }
+    }
+
+    static void clear(Transaction &tx) {
+        tx.reads.clear();
+        tx.writes.clear();
+        tx.locked.clear();
+        tx.allocations.clear();
+        tx.write_filter = 0;
+        tx.has_read = false;
+        tx.depth = 0;
+    }
+
+    // Function to wait for a lock held by a committing transaction to be released, if the contention policy is polite
+    // Returns false if the policy is not polite or the lock is still held after the last wait.
+    static bool wait_politely(std::atomic<uint64_t> &lock) {
+        if(policy().load(std::memory_order_relaxed) != TM_POLITE)
+            return false;
+        for(int round = 0; round < POLITE_ROUNDS; round++) {
+            for(volatile int i = 16 << round; i > 0; i--)
+                ;
+            if(!(lock.load(std::memory_order_acquire) & 1))
+                return true;
+        }
+        return false;
+    }
+
+    // Function to mark the thread as running a transaction, once no serial transaction runs
+    /* The flag is set before the serial flag is checked, and a serial transaction sets the serial flag before it checks the flags
+     * of the threads, with a full fence in between on both sides, so at least one of them sees the other.
+     */
+    static void enter(Transaction &tx) {
+        while(true) {
+            tx.active.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(!serial_flag().load(std::memory_order_acquire))
+                return;
+            tx.active.store(false, std::memory_order_release);
+            while(serial_flag().load(std::memory_order_acquire))
+                ;
+        }
+    }
+
+    // Function to start running serially, once every other transaction has finished
+    static void become_serial(Transaction &tx) {
+        bool expected = false;
+        while(!serial_flag().compare_exchange_weak(expected, true, std::memory_order_acquire, std::memory_order_relaxed))
+            expected = false;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::lock_guard<std::mutex> guard(registry_lock());
+        for(Transaction *other : registry()) {
+            while(other != &tx && other->active.load(std::memory_order_acquire))
+                ;
+        }
+        tx.serial = true;
+    }
+
+    // Function to end the outermost transaction, after it committed or aborted
+    static void leave(Transaction &tx) {
+        clear(tx);
+        if(tx.active.load(std::memory_order_relaxed))
+            tx.active.store(false, std::memory_order_release);
+    }
+
+    // Function to abort the calling transaction and restart it from its TM_BEGIN
+    // A serial transaction only aborts explicitly, and stays serial when it restarts.
+    [[noreturn]] static void abort(Transaction &tx, Reason reason) {
+        for(const LockEntry &entry : tx.locked)
+            entry.lock->store(entry.version, std::memory_order_release);
+        for(void *allocation : tx.allocations)
+            free(allocation);
+        leave(tx);
+        tx.stats.aborts++;
+        if(reason == VALIDATION)
+            tx.stats.validation_aborts++;
+        else if(reason == CONFLICT)
+            tx.stats.conflict_aborts++;
+        else
+            tx.stats.explicit_aborts++;
+        tx.retries++;
+        // Randomized exponential backoff, so that transactions that keep conflicting spread out
+        if(policy().load(std::memory_order_relaxed) == TM_BACKOFF) {
+            tx.backoff = tx.backoff == 0 ? 16 : std::min(tx.backoff * 2, MAX_BACKOFF);
+            tx.seed = tx.seed * 1103515245 + 12345;
+            for(volatile int i = (tx.seed >> 8) % tx.backoff; i > 0; i--)
+                ;
+        }
+        longjmp(*tx.checkpoint, 1);
+    }
+
+public:
+    // Function to check if the calling thread is in a transaction, in which case a new one is nested and needs no checkpoint
+    static bool nested() {
+        return self().depth > 0;
+    }
+
+    // Function to start a transaction, or to enter a nested one, which is flattened into the outermost transaction
+    // A nested transaction runs in the mode of the outermost one, whether it is read-only or not.
+    static void begin(jmp_buf *checkpoint, bool readonly) {
+        Transaction &tx = self();
+        if(tx.depth++ > 0)
+            return;
+        tx.checkpoint = checkpoint;
+        tx.readonly = readonly && !tx.upgraded;
+        int limit = serial_limit().load(std::memory_order_relaxed);
+        if(limit > 0 && !tx.serial) {
+            if(tx.retries >= limit)
+                become_serial(tx);
+            else
+                enter(tx);
+        }
+        tx.read_version = global_clock().load(std::memory_order_acquire);
+    }
+
+    // Function to read a word inside a transaction, or directly outside of one
+    template<typename T>
+    static T read(const T *address) {
+        static_assert(std::is_trivially_copyable<T>::value && sizeof(T) <= 8, "TL2 reads words of at most 8 bytes");
+        Transaction &tx = self();
+        if(tx.depth == 0)
+            return *address;
+        if(tx.write_filter & filter_bit(address)) {
+            for(auto entry = tx.writes.rbegin(); entry != tx.writes.rend(); ++entry) {
+                if(entry->address == address) {
+                    T value;
+                    __builtin_memcpy(&value, &entry->value, sizeof(T));
+                    return value;
+                }
+            }
+        }
+        std::atomic<uint64_t> &lock = lock_of(address);
+        while(true) {
+            uint64_t before = lock.load(std::memory_order_acquire);
+            if((before & 1) && wait_politely(lock))
+                continue;
+            T value;
+            __atomic_load(address, &value, __ATOMIC_RELAXED);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t after = lock.load(std::memory_order_relaxed);
+            if((before & 1) || before != after)
+                abort(tx, CONFLICT);
+            if((before >> 1) > tx.read_version) {
+                if(tx.has_read)
+                    abort(tx, VALIDATION);
+                tx.read_version = global_clock().load(std::memory_order_acquire);
+                continue;
+            }
+            tx.has_read = true;
+            if(!tx.readonly)
+                tx.reads.push_back(&lock);
+            return value;
+        }
+    }
+
+    // Function to write a word inside a transaction, or directly outside of one
+    template<typename T>
+    static void write(T *address, T value) {
+        static_assert(std::is_trivially_copyable<T>::value && sizeof(T) <= 8, "TL2 writes words of at most 8 bytes");
+        Transaction &tx = self();
+        if(tx.depth == 0) {
+            *address = value;
+            return;
+        }
+        // What a read-only transaction read is not logged, so it cannot be validated at commit
+        if(tx.readonly) {
+            tx.upgraded = true;
+            abort(tx, EXPLICIT);
+        }
+        uint64_t word = 0;
+        __builtin_memcpy(&word, &value, sizeof(T));
+        if(tx.write_filter & filter_bit(address)) {
+            for(WriteEntry &entry : tx.writes) {
+                if(entry.address == address) {
+                    entry.value = word;
+                    return;
+                }
+            }
+        }
+        tx.write_filter |= filter_bit(address);
+        tx.writes.push_back({address, word, (int)sizeof(T)});
+    }
+
+    // Function to allocate memory inside a transaction, or directly outside of one
+    static void *allocate(size_t bytes) {
+        Transaction &tx = self();
+        void *allocation = malloc(bytes);
+        if(allocation == NULL)
+            throw std::bad_alloc();
+        if(tx.depth > 0)
+            tx.allocations.push_back(allocation);
+        return allocation;
+    }
+
+    // Function to abort the calling transaction and restart it, counted as an explicit abort
+    [[noreturn]] static void restart() {
+        abort(self(), EXPLICIT);
+    }
+
+    // Function to choose how transactions handle conflicts, and after how many aborts in a row they run serially, 0 for never
+    // Must be called while no transactions are running.
+    static void set_contention(TMContention contention, int limit) {
+        policy().store(contention);
+        serial_limit().store(limit);
+    }
+
+    // Function to get the transaction statistics of the calling thread
+    static TMStats stats() {
+        return self().stats;
+    }
+
+    // Function to commit the calling transaction, or to leave a nested one
+    static void commit() {
+        Transaction &tx = self();
+        if(--tx.depth > 0)
+            return;
+        for(const WriteEntry &entry : tx.writes) {
+            std::atomic<uint64_t> *lock = &lock_of(entry.address);
+            uint64_t version;
+            if(held(tx, lock, version))
+                continue;
+            while(true) {
+                version = lock->load(std::memory_order_relaxed);
+                if(!(version & 1) && lock->compare_exchange_strong(version, version | 1, std::memory_order_acquire, std::memory_order_relaxed))
+                    break;
+                if(!(version & 1))
+                    continue;
+                if(!wait_politely(*lock))
+                    abort(tx, CONFLICT);
+            }
+            tx.locked.push_back({lock, version});
+        }
+        if(tx.writes.empty()) {
+            finish(tx);
+            return;
+        }
+        uint64_t write_version = global_clock().fetch_add(1, std::memory_order_acq_rel) + 1;
+        // If no other transaction committed since this one started, nothing it read can have changed
+        if(write_version != tx.read_version + 1) {
+            for(std::atomic<uint64_t> *lock : tx.reads) {
+                uint64_t version = lock->load(std::memory_order_acquire);
+                if((version & 1) && !held(tx, lock, version))
+                    abort(tx, CONFLICT);
+                if((version >> 1) > tx.read_version)
+                    abort(tx, VALIDATION);
+            }
+        }
+        for(const WriteEntry &entry : tx.writes)
+            store_word(entry);
+        for(const LockEntry &entry : tx.locked)
+            entry.lock->store(write_version << 1, std::memory_order_release);
+        finish(tx);
+    }
+
+private:
+    // Function to end a committed transaction
+    static void finish(Transaction &tx) {
+        leave(tx);
+        tx.stats.commits++;
+        tx.stats.max_retries = std::max(tx.stats.max_retries, (long)tx.retries);
+        tx.retries = 0;
+        tx.backoff = 0;
+        tx.upgraded = false;
+        if(tx.serial) {
+            tx.serial = false;
+            tx.stats.serial_commits++;
+            serial_flag().store(false, std::memory_order_release);
+        }
+    }
+};
+
+#define TM_BACKEND_NAME "tl2"
+#define TM_SYS_INIT()
+#define TM_SYS_SHUTDOWN()
+#define TM_THREAD_INIT()
+#define TM_THREAD_SHUTDOWN()
+#define TM_ALIGN(N) __attribute__((aligned(N)))
+#define TM_BEGIN(type) { jmp_buf tm_checkpoint; if(!TL2::nested()) setjmp(tm_checkpoint); TL2::begin(&tm_checkpoint, false); {
+#define TM_BEGIN_READONLY() { jmp_buf tm_checkpoint; if(!TL2::nested()) setjmp(tm_checkpoint); TL2::begin(&tm_checkpoint, true); {
+#define TM_END } TL2::commit(); }
+#define TM_READ(var) TL2::read(&(var))
+#define TM_WRITE(var, val) TL2::write(&(var), (std::remove_reference<decltype(var)>::type)(val))
+#define TM_ALLOC(size) TL2::allocate(size)
+#define TM_ABORT() TL2::restart()
+#define TM_HAS_STATS 1
+#define TM_STATS(out) ((out) = TL2::stats())
+#define TM_CONTENTION(contention, limit) TL2::set_contention(contention, limit)
+
+#endif
@@ -0,0 +1,216 @@
+
+/*
+ * Transactional concurrent vector (dynamically resizable array), built on the TM_* macros of tm.hpp.
+ */
+
+#ifndef TRANSACTIONAL_VECTOR_HPP
+#define TRANSACTIONAL_VECTOR_HPP
+
+#include <iostream>
+#include <cstdlib>
+#include "tm.hpp"
+
+// Transactional vector class implementation
+/* Every public operation runs as exactly one flat transaction, so unlike the lock-free vector it needs no descriptor. The buckets
+ * follow the same layout: bucket k holds FIRST_BUCKET_SIZE << k elements and is allocated by the first push that reaches it. The
+ * first bucket size never changes, so the index math is plain constexpr arithmetic that runs outside the STM, and the transactions
+ * only instrument the size and the buckets.
+ * Buckets are allocated one step ahead of the pushes: the push that takes the first slot of a bucket allocates the next one once its
+ * own transaction has committed, in a separate transaction that only touches the bucket's pointer. Pushes therefore rarely find
+ * their bucket missing, and the allocation stays out of their footprint. A push that does find it missing allocates it within its
+ * own transaction. Either way the bucket comes from TM_ALLOC, which frees it if the transaction aborts, and the pointer is published
+ * with TM_WRITE, so it is only visible once the allocating transaction commits and two threads never both install one.
+ * Every thread must call TM_THREAD_INIT() once before its first operation on a vector, and TM_THREAD_SHUTDOWN() after its last one.
+ * The operations nest inside a caller's transaction, which then makes them atomic along with the rest of it. atomically() runs such a
+ * transaction, and transfer(), swap() and update() are built on it to work across vectors. read() and get_size() run read-only
+ * transactions, so with TL2 they log nothing, and a get_size() that finds the size changed since it started reads it again rather
+ * than aborting, as it has read nothing else.
+ */
+class TransactionalVector {
+    // No. of buckets. Bucket k holds FIRST_BUCKET_SIZE << k elements, so 62 buckets cover every index a long long can hold.
+    static const int BUCKETS = 62;
+    // Size of the first bucket, and its highest set bit
+    static const int FIRST_BUCKET_SIZE = 2;
+    static const int FIRST_BUCKET_BIT = 1;
+    // 2-level array to store the data. Buckets are only allocated once a push reaches them.
+    int **memory = new int*[BUCKETS]();
+    // Variable to track the size of the vector
+    long long size;
+
+public:
+    // Public constructor
+    TransactionalVector() {
+        size = 0;
+        memory[0] = (int *)malloc(bucket_size(0) * sizeof(int));
+    }
+
+    // The destructor must not run while transactions on the vector are in progress
+    ~TransactionalVector() {
+        for(int i = 0; i < BUCKETS; i++)
+            free(memory[i]);
+        delete[] memory;
+    }
+
+    // Function to get the highest set bit in a given integer
+    // __builtin_clzll() gives the count of leading zeros, which is used to indirectly get the number of the highest set bit. It'll
+    // not work with 0. Hence, 0 must be checked separately.
+    static constexpr int highest_bit(long long num) {
+        return num == 0 ? 0 : 63 - __builtin_clzll(num);
+    }
+
+    // Function to get the bucket holding a given index
+    static constexpr int bucket_of(long long i) {
+        return highest_bit(i + FIRST_BUCKET_SIZE) - FIRST_BUCKET_BIT;
+    }
+
+    // Function to get the position of a given index within its bucket
+    static constexpr long long offset_of(long long i) {
+        return (i + FIRST_BUCKET_SIZE) ^ (1LL << highest_bit(i + FIRST_BUCKET_SIZE));
+    }
+
+    static constexpr long long bucket_size(int bucket) {
+        return (long long)FIRST_BUCKET_SIZE << bucket;
+    }
+
+    // Function to get the array of a bucket inside a transaction, allocating it if no transaction has done so yet
+    int *bucket_array(int bucket) {
+        int *array = TM_READ(memory[bucket]);
+        if(array == NULL) {
+            array = (int *)TM_ALLOC(bucket_size(bucket) * sizeof(int));
+            TM_WRITE(memory[bucket], array);
+        }
+        return array;
+    }
+
+    // Function to get the address of the element at a given index inside a transaction
+    // The bucket pointer is read with TM_READ as well, since a bucket allocated earlier in the same transaction is only in its log.
+    int *element(long long i) {
+        return &TM_READ(memory[bucket_of(i)])[offset_of(i)];
+    }
+
+    // Function to check whether a bucket is allocated, without a transaction
+    // The pointer is only compared, so a transaction that relies on it must read it again. It is pure, so that a push may still run
+    // inside a caller's transaction with GCC's transactional memory.
+    TM_PURE bool has_bucket(int bucket) {
+        return __atomic_load_n(&memory[bucket], __ATOMIC_RELAXED) != NULL;
+    }
+
+    // Function to allocate a bucket ahead of the pushes that will need it, in a transaction of its own
+    // Pushes and pops around the start of a bucket keep asking for the next one, so a bucket already in place is spotted without a
+    // transaction, and the transaction checks it again before allocating.
+    TM_NOINLINE void grow(int bucket) {
+        if(bucket >= BUCKETS || has_bucket(bucket))
+            return;
+        TM_BEGIN(atomic) {
+            bucket_array(bucket);
+        } TM_END;
+    }
+
+    // Function to push an element to the tail of the vector
+    // The biggest difference with the lock-free version is the lack of a descriptor object
+    TM_NOINLINE void push_back(int data) {
+        long long index;
+        TM_BEGIN(atomic) {
+            index = TM_READ(size);
+            TM_WRITE(bucket_array(bucket_of(index))[offset_of(index)], data);
+            TM_WRITE(size, index+1);
+        } TM_END;
+        if(offset_of(index) == 0)
+            grow(bucket_of(index) + 1);
+    }
+
+    // Function to remove an element from the tail of the vector, returning -1 if it is empty
+    TM_NOINLINE int pop_back() {
+        int data;
+        TM_BEGIN(atomic) {
+            long long local_size = TM_READ(size);
+            // The transaction must reach TM_END to commit, so an empty vector is not handled with an early return
+            if(local_size == 0)
+                data = -1;
+            else {
+                data = TM_READ(*element(local_size-1));
+                TM_WRITE(size, local_size-1);
+            }
+        } TM_END;
+        return data;
+    }
+
+    // Function to write a given element to a given position
+    TM_NOINLINE void write(long long i, int data) {
+        TM_BEGIN(atomic) {
+            TM_WRITE(*element(i), data);
+        } TM_END;
+    }
+
+    // Function to read an element at a given position
+    TM_NOINLINE int read(long long i) {
+        int data;
+        TM_BEGIN_READONLY() {
+            data = TM_READ(*element(i));
+        } TM_END;
+        return data;
+    }
+
+    // Function to get the current size of the vector
+    TM_NOINLINE long long get_size() {
+        long long local_size;
+        TM_BEGIN_READONLY() {
+            local_size = TM_READ(size);
+        } TM_END;
+        return local_size;
+    }
+
+    // Function to run a given function as one transaction, along with every vector operation it makes
+    /* This is how operations on one or more vectors are composed: whatever the function does takes effect together, or not at all,
+     * and the transaction may run it more than once before it commits. The function must therefore only change shared data through
+     * the vectors or TM_WRITE, and must not rely on locals it changed on an earlier run.
+     *     TransactionalVector::atomically([&] {
+     *         if(a.get_size() > 0)
+     *             b.push_back(a.pop_back());
+     *     });
+     * It is never inlined, as GCC 12 crashes compiling a loop that such a transaction, nesting the vector's own ones, was inlined into.
+     */
+    template<typename Function>
+    __attribute__((noinline)) static void atomically(Function function) {
+        TM_BEGIN(atomic) {
+            function();
+        } TM_END;
+    }
+
+    // Function to move the tail element of one vector to the tail of another, returning false if the first one is empty
+    static bool transfer(TransactionalVector &from, TransactionalVector &to) {
+        bool moved;
+        atomically([&] {
+            moved = from.get_size() > 0;
+            if(moved)
+                to.push_back(from.pop_back());
+        });
+        return moved;
+    }
+
+    // Function to swap an element of one vector with an element of another, or of the same one
+    static void swap(TransactionalVector &a, long long i, TransactionalVector &b, long long j) {
+        atomically([&] {
+            int data = a.read(i);
+            a.write(i, b.read(j));
+            b.write(j, data);
+        });
+    }
+
+    // Function to write a given no. of elements at once, the k-th of them at indices[k] of *vectors[k]
+    static void update(TransactionalVector *const *vectors, const long long *indices, const int *values, int count) {
+        atomically([&] {
+            for(int k = 0; k < count; k++)
+                vectors[k]->write(indices[k], values[k]);
+        });
+    }
+
+    // Function to display the contents of the vector
+    void display() {
+        for(long long i = 0; i < size; i++)
+            std::cout << memory[bucket_of(i)][offset_of(i)] << " ";
+        std::cout << std::endl;
+    }
+};
+
+#endif
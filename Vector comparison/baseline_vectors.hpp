@@ -0,0 +1,176 @@
+
+/*
+ * Lock-based vectors that the concurrent vectors are compared against: a std::vector behind a single mutex, and a bucketed vector
+ * whose elements are guarded by striped locks.
+ */
+
+#ifndef BASELINE_VECTORS_HPP
+#define BASELINE_VECTORS_HPP
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+// std::vector guarded by a single mutex, which every operation takes
+class MutexVector {
+	std::mutex lock;
+	std::vector<int> elements;
+
+public:
+	void push_back(int data) {
+		std::lock_guard<std::mutex> guard(lock);
+		elements.push_back(data);
+	}
+
+	// Function to pop the last element into data, returning false if the vector is empty
+	bool pop_back(int &data) {
+		std::lock_guard<std::mutex> guard(lock);
+		if(elements.empty())
+			return false;
+		data = elements.back();
+		elements.pop_back();
+		return true;
+	}
+
+	// Function to read the element at a given index, returning false if it is out of range
+	bool read(long long i, int &data) {
+		std::lock_guard<std::mutex> guard(lock);
+		if(i < 0 || i >= (long long)elements.size())
+			return false;
+		data = elements[i];
+		return true;
+	}
+
+	bool write(long long i, int data) {
+		std::lock_guard<std::mutex> guard(lock);
+		if(i < 0 || i >= (long long)elements.size())
+			return false;
+		elements[i] = data;
+		return true;
+	}
+
+	long long size() {
+		std::lock_guard<std::mutex> guard(lock);
+		return elements.size();
+	}
+
+	// Function to combine every element with xor, holding the lock for the whole scan
+	int scan() {
+		std::lock_guard<std::mutex> guard(lock);
+		int result = 0;
+		for(int e : elements)
+			result ^= e;
+		return result;
+	}
+};
+
+// Vector with a lock for the tail and striped locks for the elements
+/* The elements are kept in the same buckets as the lock-free vector, so they never move and an access to one element only has to
+ * lock the stripe holding it. Runs of BLOCK consecutive indices share a stripe, so a scan takes one lock per run. Pushes and pops
+ * are serialized by the tail lock, and change the size while holding the stripe of the element they add or remove, so that a read
+ * holding the same stripe sees the element and the size agree.
+ */
+class ShardedVector {
+	static const int BUCKETS = 62;
+	static const int FIRST_BUCKET_SIZE = 2;
+	static const int FIRST_BUCKET_BIT = 1;
+	static const int STRIPES = 64;
+	static const int BLOCK = 64;
+
+	// Every stripe has a cache line to itself, so that threads working on different stripes do not contend
+	struct alignas(64) Stripe {
+		std::mutex lock;
+	};
+
+	int *memory[BUCKETS];
+	Stripe stripes[STRIPES];
+	alignas(64) std::mutex tail_lock;
+	std::atomic<long long> length;
+
+	static int highest_bit(long long num) {
+		if(!num) return 0;
+		return 63 - __builtin_clzll(num);
+	}
+
+	// Function to get the element at a given index, whose bucket must be allocated
+	int &element(long long i) {
+		int bucket = highest_bit(i + FIRST_BUCKET_SIZE) - FIRST_BUCKET_BIT;
+		return memory[bucket][i + FIRST_BUCKET_SIZE - ((long long)FIRST_BUCKET_SIZE << bucket)];
+	}
+
+	std::mutex &stripe(long long i) {
+		return stripes[(i / BLOCK) % STRIPES].lock;
+	}
+
+public:
+	ShardedVector() : length(0) {
+		for(int i = 0; i < BUCKETS; i++)
+			memory[i] = NULL;
+	}
+
+	~ShardedVector() {
+		for(int i = 0; i < BUCKETS; i++)
+			delete[] memory[i];
+	}
+
+	void push_back(int data) {
+		std::lock_guard<std::mutex> tail(tail_lock);
+		long long i = length.load(std::memory_order_relaxed);
+		int bucket = highest_bit(i + FIRST_BUCKET_SIZE) - FIRST_BUCKET_BIT;
+		if(memory[bucket] == NULL)
+			memory[bucket] = new int[(long long)FIRST_BUCKET_SIZE << bucket];
+		std::lock_guard<std::mutex> guard(stripe(i));
+		element(i) = data;
+		length.store(i + 1, std::memory_order_relaxed);
+	}
+
+	bool pop_back(int &data) {
+		std::lock_guard<std::mutex> tail(tail_lock);
+		long long i = length.load(std::memory_order_relaxed) - 1;
+		if(i < 0)
+			return false;
+		std::lock_guard<std::mutex> guard(stripe(i));
+		data = element(i);
+		length.store(i, std::memory_order_relaxed);
+		return true;
+	}
+
+	bool read(long long i, int &data) {
+		if(i < 0)
+			return false;
+		std::lock_guard<std::mutex> guard(stripe(i));
+		if(i >= length.load(std::memory_order_relaxed))
+			return false;
+		data = element(i);
+		return true;
+	}
+
+	bool write(long long i, int data) {
+		if(i < 0)
+			return false;
+		std::lock_guard<std::mutex> guard(stripe(i));
+		if(i >= length.load(std::memory_order_relaxed))
+			return false;
+		element(i) = data;
+		return true;
+	}
+
+	long long size() {
+		return length.load(std::memory_order_relaxed);
+	}
+
+	// Function to combine every element with xor, one run of BLOCK indices at a time
+	// Each run is consistent on its own, but pushes and pops can land between two runs.
+	int scan() {
+		int result = 0;
+		for(long long first = 0; first < length.load(std::memory_order_relaxed); first += BLOCK) {
+			std::lock_guard<std::mutex> guard(stripe(first));
+			long long end = std::min(first + BLOCK, length.load(std::memory_order_relaxed));
+			for(long long i = first; i < end; i++)
+				result ^= element(i);
+		}
+		return result;
+	}
+};
+
+#endif
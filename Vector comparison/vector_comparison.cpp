@@ -0,0 +1,277 @@
+/*
+ * Benchmark running the same workloads against the lock-free vector, the transactional vector, a std::vector behind a mutex and a
+ * vector with striped locks, over a growing no. of threads.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <pthread.h>
+#include <getopt.h>
+#include "../Lock-free concurrent vector/lock_free_vector.hpp"
+#include "baseline_vectors.hpp"
+#include "../Transactional concurrent vector/transactional_vector.hpp"
+
+typedef std::chrono::steady_clock benchmark_clock;
+
+// Results of the reads and scans are written here, so that the compiler cannot drop them
+volatile int sink;
+
+// Workloads, each made of operations of the same kind on every thread
+/* PUSH only pushes. MIX pushes or pops with equal probability, starting from the prefilled vector. READ reads a random index of the
+ * prefilled vector, and writes it one time in 20. SCAN reads every element of the prefilled vector in turn, and every element read
+ * counts as an operation.
+ */
+enum Workload {PUSH, MIX, READ, SCAN};
+const char *WORKLOAD_NAMES[] = {"push", "mix", "read", "scan"};
+
+// Adapters giving every vector the same interface
+/* pop_back() and read() return false on an empty vector or an index out of range. scan() combines every element with xor, each
+ * vector using the most efficient scan it offers: a validated reduce() on the lock-free vector, one lock per run of elements on
+ * the striped one, the whole scan under the lock on the mutex one, and a transaction per element on the transactional vector.
+ */
+struct LockFreeAdapter {
+	static const char *name() {return "lock-free";}
+	Vector<int> v;
+	void push_back(int data) {v.push_back(data);}
+	bool pop_back(int &data) {
+		std::optional<int> e = v.pop_back();
+		if(e)
+			data = *e;
+		return (bool)e;
+	}
+	bool read(long long i, int &data) {
+		std::optional<int> e = v.read(i);
+		if(e)
+			data = *e;
+		return (bool)e;
+	}
+	void write(long long i, int data) {v.write(i, data);}
+	int scan() {return v.reduce(0, [](int a, int b) {return a ^ b;});}
+};
+
+// The transactional vector has no bounds checks, so the workloads only read indices below the prefilled size
+struct TransactionalAdapter {
+	static const char *name() {return "transactional";}
+	TransactionalVector v;
+	void push_back(int data) {v.push_back(data);}
+	bool pop_back(int &data) {
+		data = v.pop_back();
+		return data != -1;
+	}
+	bool read(long long i, int &data) {
+		data = v.read(i);
+		return true;
+	}
+	void write(long long i, int data) {v.write(i, data);}
+	int scan() {
+		int result = 0;
+		long long size = v.get_size();
+		for(long long i = 0; i < size; i++)
+			result ^= v.read(i);
+		return result;
+	}
+};
+
+template<typename Lockable>
+struct LockAdapter {
+	static const char *name();
+	Lockable v;
+	void push_back(int data) {v.push_back(data);}
+	bool pop_back(int &data) {return v.pop_back(data);}
+	bool read(long long i, int &data) {return v.read(i, data);}
+	void write(long long i, int data) {v.write(i, data);}
+	int scan() {return v.scan();}
+};
+
+template<> const char *LockAdapter<MutexVector>::name() {return "mutex";}
+template<> const char *LockAdapter<ShardedVector>::name() {return "sharded";}
+
+// Structure to pass on the parameters of a run to the threads
+template<typename Adapter>
+struct RunArguments {
+	Adapter *vector;
+	Workload workload;
+	long ops;
+	long long prefill;
+	std::atomic<int> *ready;
+	std::atomic<bool> *go;
+	unsigned int seed;
+	// Elements read by the thread, combined with xor
+	int result;
+};
+
+// Function to get the next pseudo-random no. of a thread
+inline unsigned int next_random(unsigned int &seed) {
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+// Function run by every thread of a run
+template<typename Adapter>
+void *worker(void *ptr) {
+	RunArguments<Adapter> *args = (RunArguments<Adapter> *)ptr;
+	Adapter &v = *args->vector;
+	unsigned int seed = args->seed;
+	int data = 0, result = 0;
+	TM_THREAD_INIT();
+	args->ready->fetch_add(1);
+	while(!args->go->load())
+		;
+	switch(args->workload) {
+	case PUSH:
+		for(long i = 0; i < args->ops; i++)
+			v.push_back(i);
+		break;
+	case MIX:
+		for(long i = 0; i < args->ops; i++) {
+			if(next_random(seed) & 1)
+				v.push_back(i);
+			else
+				v.pop_back(data);
+		}
+		break;
+	case READ:
+		for(long i = 0; i < args->ops; i++) {
+			unsigned int r = next_random(seed);
+			if(r % 20 == 0)
+				v.write(r % args->prefill, i);
+			else if(v.read(r % args->prefill, data))
+				result ^= data;
+		}
+		break;
+	case SCAN:
+		for(long i = 0; i < args->ops; i += args->prefill)
+			result ^= v.scan();
+		break;
+	}
+	TM_THREAD_SHUTDOWN();
+	args->result = result;
+	return NULL;
+}
+
+// Function to get the throughput in millions of operations per second of a run
+template<typename Adapter>
+double run(Workload workload, int threads, long ops, long long prefill) {
+	Adapter *vector = new Adapter();
+	for(long long i = 0; i < prefill; i++)
+		vector->push_back(i);
+	// A scan covers prefill elements, so the no. of operations is rounded up to whole scans
+	if(workload == SCAN)
+		ops = (ops + prefill - 1) / prefill * prefill;
+	std::atomic<int> ready(0);
+	std::atomic<bool> go(false);
+	std::vector<RunArguments<Adapter> > args(threads);
+	std::vector<pthread_t> thread(threads);
+	for(int i = 0; i < threads; i++) {
+		args[i] = {vector, workload, ops, prefill, &ready, &go, 2463534242u + 7919u * i, 0};
+		pthread_create(&thread[i], NULL, worker<Adapter>, &args[i]);
+	}
+	// The threads wait until all of them are running, so the timed region excludes thread creation
+	while(ready.load() < threads)
+		;
+	auto t1 = benchmark_clock::now();
+	go = true;
+	for(int i = 0; i < threads; i++)
+		pthread_join(thread[i], NULL);
+	double seconds = std::chrono::duration<double>(benchmark_clock::now() - t1).count();
+	for(int i = 0; i < threads; i++)
+		sink = args[i].result;
+	delete vector;
+	return threads * ops / seconds / 1e6;
+}
+
+// Function to get the best throughput of a number of runs
+template<typename Adapter>
+double best_run(Workload workload, int threads, long ops, long long prefill, int repetitions) {
+	double best = 0;
+	for(int i = 0; i < repetitions; i++)
+		best = std::max(best, run<Adapter>(workload, threads, ops, prefill));
+	return best;
+}
+
+// Structure to hold a vector along with the function that benchmarks it
+struct Contender {
+	const char *name;
+	double (*measure)(Workload, int, long, long long, int);
+};
+
+// Main function
+int main(int argc, char **argv) {
+	int max_threads = 8;
+	long ops = 200000;
+	long long prefill = 1 << 16;
+	int repetitions = 3;
+	std::string workloads = "push,mix,read,scan";
+	int c;
+	while((c = getopt(argc, argv, "t:n:p:r:w:")) != -1) {
+		switch(c) {
+		case 't': max_threads = atoi(optarg); break;
+		case 'n': ops = atol(optarg); break;
+		case 'p': prefill = atoll(optarg); break;
+		case 'r': repetitions = atoi(optarg); break;
+		case 'w': workloads = optarg; break;
+		default:
+			std::cerr << "Usage: " << argv[0] << " [-t max threads] [-n ops per thread] [-p prefill] [-r repetitions]"
+				<< " [-w push,mix,read,scan]" << std::endl;
+			return 1;
+		}
+	}
+	if(prefill < 1) {
+		std::cerr << "The prefill must be at least 1, the read and scan workloads need elements to work on" << std::endl;
+		return 1;
+	}
+
+	TM_SYS_INIT();
+	// The main thread prefills the vectors
+	TM_THREAD_INIT();
+	std::vector<Contender> contenders = {
+		{LockFreeAdapter::name(), best_run<LockFreeAdapter>},
+		{TransactionalAdapter::name(), best_run<TransactionalAdapter>},
+		{LockAdapter<MutexVector>::name(), best_run<LockAdapter<MutexVector> >},
+		{LockAdapter<ShardedVector>::name(), best_run<LockAdapter<ShardedVector> >},
+	};
+
+	std::cout << ops << " ops per thread, prefill " << prefill << ", best of " << repetitions << ", Mops/s";
+	std::cout << ", " << TM_BACKEND_NAME << " transactions";
+	std::cout << std::endl;
+	std::cout << std::setw(8) << "workload" << std::setw(8) << "threads";
+	for(const Contender &contender : contenders)
+		std::cout << std::setw(15) << contender.name;
+	std::cout << std::setw(15) << "fastest" << std::endl;
+
+	std::stringstream list(workloads);
+	std::string name;
+	while(std::getline(list, name, ',')) {
+		int workload = 0;
+		while(workload < 4 && name != WORKLOAD_NAMES[workload])
+			workload++;
+		if(workload == 4) {
+			std::cerr << "Unknown workload " << name << std::endl;
+			return 1;
+		}
+		for(int threads = 1; threads <= max_threads; threads *= 2) {
+			std::cout << std::setw(8) << name << std::setw(8) << threads << std::fixed << std::setprecision(2);
+			const char *fastest = NULL;
+			double best = 0;
+			for(const Contender &contender : contenders) {
+				double mops = contender.measure((Workload)workload, threads, ops, prefill, repetitions);
+				std::cout << std::setw(15) << mops;
+				if(mops > best) {
+					best = mops;
+					fastest = contender.name;
+				}
+			}
+			std::cout << std::setw(15) << fastest << std::endl;
+		}
+	}
+	TM_THREAD_SHUTDOWN();
+	TM_SYS_SHUTDOWN();
+	return 0;
+}